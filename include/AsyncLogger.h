@@ -0,0 +1,126 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2016, Neobotix GmbH
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Neobotix nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+#ifndef INCLUDE_ASYNCLOGGER_H_
+#define INCLUDE_ASYNCLOGGER_H_
+
+#include "rclcpp/rclcpp.hpp"
+
+#include <atomic>
+#include <cstdarg>
+#include <cstdint>
+#include <memory>
+
+
+namespace neo_local_planner {
+
+/*
+ * Logging for the control path.
+ * Messages are formatted into a lock-free ring buffer and written to rclcpp logging
+ * by a background thread, so logging never blocks or flushes on the calling thread.
+ * If the buffer is full messages are dropped and counted.
+ * All loggers in a process share one background thread, which also refreshes
+ * the cached logger level (changes take effect within one drain period).
+ */
+class AsyncLogger {
+public:
+	enum level_t {
+		LEVEL_DEBUG,
+		LEVEL_INFO,
+		LEVEL_WARN,
+		LEVEL_ERROR
+	};
+
+	explicit AsyncLogger(const rclcpp::Logger& logger, size_t capacity = 256);
+
+	~AsyncLogger();
+
+	AsyncLogger(const AsyncLogger&) = delete;
+	AsyncLogger& operator=(const AsyncLogger&) = delete;
+
+	void log(level_t level, const char* format, ...) __attribute__((format(printf, 3, 4)));
+
+	/*
+	 * Like log(), but emits a given message (identified by its format string) at most once per period.
+	 * Suppressed messages are counted and the count is appended to the next emitted one.
+	 */
+	void logThrottled(double period, level_t level, const char* format, ...) __attribute__((format(printf, 4, 5)));
+
+	uint64_t getNumDropped() const { return m_num_dropped; }
+
+private:
+	static const size_t max_length = 256;
+	static const size_t num_throttles = 64;
+
+	struct entry_t {
+		std::atomic<size_t> sequence {0};
+		level_t level = LEVEL_INFO;
+		char text[max_length] = {};
+	};
+
+	struct throttle_t {
+		std::atomic<const char*> format {0};
+		std::atomic<int64_t> last_time {0};
+		std::atomic<uint64_t> num_suppressed {0};
+	};
+
+	class DrainThread;
+
+	bool isEnabled(level_t level) const { return int(level) >= m_min_level.load(std::memory_order_relaxed); }
+
+	void updateLevel();
+
+	void push(level_t level, uint64_t num_suppressed, const char* format, va_list args);
+
+	void drain();
+
+	rclcpp::Logger m_logger;
+	std::unique_ptr<entry_t[]> m_entries;
+	size_t m_capacity = 0;
+	std::atomic<size_t> m_write_pos {0};
+	std::atomic<size_t> m_read_pos {0};
+	std::atomic<uint64_t> m_num_dropped {0};
+	uint64_t m_num_dropped_reported = 0;
+
+	throttle_t m_throttles[num_throttles];
+
+	std::atomic<int> m_min_level {LEVEL_DEBUG};		// lowest enabled level
+	std::shared_ptr<DrainThread> m_drain_thread;
+
+};
+
+
+} // neo_local_planner
+
+#endif /* INCLUDE_ASYNCLOGGER_H_ */
@@ -0,0 +1,106 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2016, Neobotix GmbH
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Neobotix nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+
+#ifndef INCLUDE_EGOCOSTGRID_H_
+#define INCLUDE_EGOCOSTGRID_H_
+
+#include <cstddef>
+#include <vector>
+
+
+namespace neo_local_planner {
+
+/*
+ * Small robot-centric copy of the costmap, aligned with the robot heading.
+ * Rebuilt once per cycle, so that all cost queries around the robot hit a compact
+ * array instead of rows scattered across the full costmap.
+ * Each cell takes the max of the 3x3 costmap cells around its center, so rotating
+ * the grid never hides an obstacle, at the price of inflating costs by up to 1.5 cells.
+ * The grid reaches 3/4 of its size ahead of the robot and 1/4 behind.
+ * Queries take coordinates in costmap frame and return false if they leave the grid.
+ */
+class EgoCostGrid {
+public:
+	/*
+	 * Allocates a size x size grid, cell size equals costmap resolution.
+	 */
+	void configure(int size, double resolution);
+
+	void clear();
+
+	bool isValid() const { return m_is_valid; }
+
+	void invalidate() { m_is_valid = false; }
+
+	int getSize() const { return m_size; }
+
+	/*
+	 * Resamples given row major char map around pose (x, y, yaw) in costmap frame.
+	 * Cells outside of the map take the closest border cell, like worldToMapEnforceBounds().
+	 */
+	void update(const unsigned char* costs, int size_x, int size_y,
+				double origin_x, double origin_y, double resolution,
+				double x, double y, double yaw);
+
+	bool getCost(double x, double y, unsigned char& cost) const;
+
+	/*
+	 * Max and average cost [0..1] of the cells on the line from (x0, y0) to (x1, y1).
+	 */
+	bool getMaxLineCost(double x0, double y0, double x1, double y1, double& cost) const;
+
+	bool getAvgLineCost(double x0, double y0, double x1, double y1, double& cost) const;
+
+private:
+	bool toCell(double x, double y, int& cx, int& cy) const;
+
+	int m_size = 0;
+	double m_resolution = 0;
+	bool m_is_valid = false;
+
+	// grid pose in costmap frame
+	double m_x = 0;
+	double m_y = 0;
+	double m_cos_yaw = 1;
+	double m_sin_yaw = 0;
+
+	std::vector<unsigned char> m_costs;		// [y][x], x points forward
+
+};
+
+
+} // neo_local_planner
+
+#endif /* INCLUDE_EGOCOSTGRID_H_ */
@@ -0,0 +1,156 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2016, Neobotix GmbH
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Neobotix nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+#ifndef INCLUDE_FLIGHTRECORDER_H_
+#define INCLUDE_FLIGHTRECORDER_H_
+
+#include <cstdint>
+#include <cstddef>
+#include <memory>
+#include <string>
+
+
+namespace neo_local_planner {
+
+enum stage_t {
+	STAGE_PREDICT,
+	STAGE_GRADIENTS,
+	STAGE_SCAN,
+	STAGE_PATH,
+	STAGE_CONTROL,
+	NUM_STAGES
+};
+
+enum dump_reason_t {
+	DUMP_REQUESTED = 0,
+	DUMP_STUCK = 1,
+	DUMP_EMERGENCY_BRAKE = 2,
+	NUM_DUMP_REASONS
+};
+
+enum record_flags_t {
+	RECORD_HAVE_OBSTACLE = 1,
+	RECORD_GOAL_TARGET = 2,
+	RECORD_EMERGENCY_BRAKE = 4
+};
+
+#pragma pack(push, 1)
+
+/*
+ * Telemetry of one control cycle.
+ */
+struct flight_record_t {
+	uint64_t cycle;
+	int64_t stamp;						// [ns]
+	float pose[3];						// predicted pose (x, y, yaw) in local frame
+	float pos_error[2];
+	float yaw_error;
+	float center_cost;
+	float delta_cost[3];				// (x, y, yaw)
+	float obstacle_dist;
+	float pose_latency;
+	float odom_latency;
+	float control_vel[3];				// raw control values (x, y, yaw)
+	float cmd_vel[3];					// after low pass and limits (x, y, yaw)
+	uint32_t stage_time[NUM_STAGES];	// [ns]
+	uint8_t state;
+	uint8_t flags;						// see record_flags_t
+	uint8_t degrade_level;
+};
+
+/*
+ * Header of a dump slot, followed by num_records records, oldest first.
+ * A dump file holds one slot per dump_reason_t, each sized for capacity records.
+ * Slots which were never dumped are all zero.
+ */
+struct flight_record_header_t {
+	char magic[8];						// "NEOFREC"
+	uint32_t version;
+	uint32_t record_size;
+	uint32_t capacity;
+	uint32_t num_records;
+	uint32_t reason;					// see dump_reason_t
+	uint64_t dump_count;
+};
+
+#pragma pack(pop)
+
+static const char flight_record_magic[8] = "NEOFREC";
+static const uint32_t flight_record_version = 3;
+
+/*
+ * Fixed size ring buffer of per cycle telemetry.
+ * The dump file is created and mapped up front, so neither recording nor dumping
+ * allocates memory or does system calls. Each reason dumps into its own slot, so a
+ * brake right after a stuck dump does not overwrite it. Not thread safe.
+ */
+class FlightRecorder {
+public:
+	FlightRecorder(size_t capacity, const std::string& file_path);
+
+	~FlightRecorder();
+
+	FlightRecorder(const FlightRecorder&) = delete;
+	FlightRecorder& operator=(const FlightRecorder&) = delete;
+
+	void add(const flight_record_t& record);
+
+	/*
+	 * Copies the history into the slot of 'reason', returns false if the file is not available.
+	 */
+	bool dump(dump_reason_t reason);
+
+	bool isMapped() const { return m_mapping != 0; }
+
+	const std::string& getFilePath() const { return m_file_path; }
+
+private:
+	std::unique_ptr<flight_record_t[]> m_records;
+	size_t m_capacity = 0;
+	size_t m_head = 0;
+	size_t m_count = 0;
+	uint64_t m_dump_count = 0;
+
+	std::string m_file_path;
+	int m_fd = -1;
+	void* m_mapping = 0;
+	size_t m_mapping_size = 0;
+	size_t m_slot_size = 0;
+
+};
+
+
+} // neo_local_planner
+
+#endif /* INCLUDE_FLIGHTRECORDER_H_ */
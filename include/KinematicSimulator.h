@@ -0,0 +1,216 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2016, Neobotix GmbH
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Neobotix nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+
+#ifndef INCLUDE_KINEMATICSIMULATOR_H_
+#define INCLUDE_KINEMATICSIMULATOR_H_
+
+#include "NeoLocalPlanner.h"
+
+#include <nav2_costmap_2d/costmap_2d.hpp>
+#include <rclcpp_lifecycle/lifecycle_node.hpp>
+
+#include <array>
+#include <limits>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+
+namespace neo_local_planner {
+
+/*
+ * Rectangular obstacle, moving with constant velocity while active.
+ */
+struct sim_obstacle_t {
+	double x0 = 0;					// [m]
+	double y0 = 0;
+	double x1 = 0;
+	double y1 = 0;
+	double vel_x = 0;				// [m/s]
+	double vel_y = 0;
+	double begin_time = 0;			// active from [s]
+	double end_time = std::numeric_limits<double>::infinity();
+};
+
+struct sim_scenario_t {
+	std::string name;
+	double size_x = 10;				// map size [m]
+	double size_y = 10;
+	double resolution = 0.05;		// [m]
+	double origin_x = 0;			// [m]
+	double origin_y = 0;
+	double robot_radius = 0.3;		// inscribed radius, closer counts as collision [m]
+	double inflation_radius = 0.6;	// [m]
+	double cost_scaling = 5;		// like nav2 inflation layer [1/m]
+	double start[3] = {};			// x, y, yaw
+	double goal[3] = {};
+	std::vector<std::array<double, 2>> waypoints;		// plan goes start -> waypoints -> goal
+	std::vector<sim_obstacle_t> obstacles;
+	double timeout = 60;			// [s]
+};
+
+struct sim_params_t {
+	enum drive_model_t {
+		DRIVE_DIFFERENTIAL,
+		DRIVE_HOLONOMIC
+	};
+
+	drive_model_t drive_model = DRIVE_DIFFERENTIAL;
+	double control_rate = 20;		// [Hz]
+	int num_substeps = 10;			// integration steps per control cycle
+	double actuator_lag = 0.1;		// first order time constant [s]
+	double odom_noise_pos = 0;		// std dev [m]
+	double odom_noise_yaw = 0;		// std dev [rad]
+	double odom_noise_vel = 0;		// std dev [m/s], [rad/s]
+	unsigned int seed = 1;
+	std::string plugin_name = "FollowPath";
+};
+
+static const double max_clearance = 2;	// search radius for clearance [m]
+
+struct sim_result_t {
+	std::string name;
+	bool is_goal_reached = false;
+	bool is_collision = false;
+	double completion_time = 0;		// simulated [s]
+	double mean_tracking_error = 0;	// distance to plan [m]
+	double max_tracking_error = 0;
+	double min_clearance = 0;		// distance to closest lethal cell, at most max_clearance [m]
+	size_t num_cycles = 0;
+	double mean_cycle_time = 0;		// computeVelocityCommands() wall time [s]
+	double p99_cycle_time = 0;
+	double max_cycle_time = 0;
+	double real_time_factor = 0;	// simulated / wall time
+};
+
+/*
+ * Parses a scenario file, one entry per line, '#' starts a comment:
+ *   name <string>
+ *   map <size_x> <size_y> <resolution> <origin_x> <origin_y>
+ *   robot <radius> <inflation_radius> <cost_scaling>
+ *   start <x> <y> <yaw>
+ *   goal <x> <y> <yaw>
+ *   waypoint <x> <y>
+ *   obstacle <x0> <y0> <x1> <y1> [<vel_x> <vel_y> [<begin_time> [<end_time>]]]
+ *   timeout <seconds>
+ * Returns false and sets error on failure.
+ */
+bool load_scenario(const std::string& file_name, sim_scenario_t& scenario, std::string& error);
+
+/*
+ * Headless closed loop simulation of one NeoLocalPlanner instance.
+ * Integrates the commands with a differential or holonomic kinematic model, feeds back
+ * noisy odometry and runs on simulated ROS time, so it runs as fast as the planner does.
+ * Map to odom is identity. Several simulators can run in parallel, each has its own node.
+ * Background stages (perception_rate, real_time_mode) run on wall time and are not simulated.
+ */
+class KinematicSimulator {
+public:
+	/*
+	 * options are passed to the node, use them to set planner parameters.
+	 */
+	KinematicSimulator(	const sim_scenario_t& scenario, const sim_params_t& params,
+						const std::string& node_name, const rclcpp::NodeOptions& options);
+
+	~KinematicSimulator();
+
+	KinematicSimulator(const KinematicSimulator&) = delete;
+	KinematicSimulator& operator=(const KinematicSimulator&) = delete;
+
+	/*
+	 * Runs one control cycle, returns false once done (goal reached, collision or timeout).
+	 */
+	bool step();
+
+	/*
+	 * Runs until done.
+	 */
+	const sim_result_t& run();
+
+	const sim_result_t& getResult() const { return m_result; }
+
+	double getTime() const { return m_time; }
+
+	const nav2_costmap_2d::Costmap2D& getCostmap() const { return *m_costmap; }
+
+private:
+	void updateCostmap();
+
+	/*
+	 * Marks obstacle cells lethal and applies inflation, keeping the max cost.
+	 */
+	void rasterize(const sim_obstacle_t& obstacle, double offset_x, double offset_y, unsigned char* costs) const;
+
+	double computeClearance(double x, double y) const;
+
+	void setTime(double time);
+
+	void finish();
+
+private:
+	sim_scenario_t m_scenario;
+	sim_params_t m_params;
+
+	rclcpp_lifecycle::LifecycleNode::SharedPtr m_node;
+	std::shared_ptr<tf2_ros::Buffer> m_tf;
+	std::shared_ptr<nav2_costmap_2d::Costmap2D> m_costmap;
+	std::shared_ptr<NeoLocalPlanner> m_planner;
+
+	std::vector<unsigned char> m_static_costs;		// inflated static obstacles
+	std::vector<unsigned char> m_inflation_kernel;	// cost by cell offset, (2 * r + 1)^2
+	int m_inflation_cells = 0;
+	PlanStorage m_plan;
+
+	std::mt19937 m_generator;
+	std::normal_distribution<double> m_noise;
+
+	double m_time = 0;				// simulated time since start [s]
+	double m_pose[3] = {};			// true pose in odom frame
+	double m_vel[3] = {};			// actual velocity in robot frame (x, y, yaw)
+	double m_cmd[3] = {};			// last command
+
+	bool m_is_done = false;
+	double m_sum_tracking_error = 0;
+	std::vector<double> m_cycle_times;
+	double m_wall_time = 0;
+	sim_result_t m_result;
+
+};
+
+
+} // neo_local_planner
+
+#endif /* INCLUDE_KINEMATICSIMULATOR_H_ */
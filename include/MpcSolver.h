@@ -0,0 +1,139 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2016, Neobotix GmbH
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Neobotix nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+#ifndef INCLUDE_MPCSOLVER_H_
+#define INCLUDE_MPCSOLVER_H_
+
+#include <functional>
+#include <vector>
+
+
+namespace neo_local_planner {
+
+/*
+ * Short horizon model predictive control for a holonomic (or differential) base.
+ * Optimizes a sequence of (vx, vy, yawrate) commands by projected gradient descent
+ * with backtracking, gradients are computed analytically via the adjoint of the
+ * kinematic model (midpoint integration, like the planner's pose prediction). Velocity and acceleration limits are enforced by projection,
+ * the previous solution is used as warm start.
+ */
+class MpcSolver {
+public:
+	struct pose_t {
+		double x = 0;
+		double y = 0;
+		double yaw = 0;
+	};
+
+	struct control_t {
+		double vx = 0;
+		double vy = 0;
+		double yawrate = 0;
+	};
+
+	struct params_t {
+		int horizon = 10;				// number of steps
+		double dt = 0.1;				// step time [s]
+		int max_iterations = 20;		// per solve
+		double weight_pos = 1;			// per squared position error [1/m^2]
+		double weight_yaw = 0.3;		// per squared yaw error [1/rad^2]
+		double weight_cost = 5;			// per costmap cost [0..1]
+		double weight_smooth = 0.1;		// per squared velocity change
+		control_t min_vel;
+		control_t max_vel;
+		control_t acc_lim;				// [m/s^2], [rad/s^2]
+	};
+
+	struct stats_t {
+		int num_iterations = 0;
+		double initial_cost = 0;
+		double final_cost = 0;
+	};
+
+	/*
+	 * Returns cost [0..1] at (x, y) and writes its gradient into grad[2].
+	 */
+	typedef std::function<double(double x, double y, double* grad)> cost_func_t;
+
+	/*
+	 * Allocates all buffers, forgets the warm start.
+	 */
+	void setParams(const params_t& params);
+
+	const params_t& getParams() const { return m_params; }
+
+	/*
+	 * Changes velocity limits without losing the warm start.
+	 */
+	void setVelocityLimits(const control_t& min_vel, const control_t& max_vel);
+
+	void reset();
+
+	/*
+	 * Computes the command sequence starting at 'start' with current velocity 'start_vel',
+	 * tracking reference poses 1 to horizon (reference[0] is ignored). Returns the first command.
+	 */
+	control_t solve(const pose_t& start, const control_t& start_vel,
+					const std::vector<pose_t>& reference, const cost_func_t& cost_func, stats_t* stats = 0);
+
+	const std::vector<control_t>& getSolution() const { return m_controls; }
+
+	const std::vector<pose_t>& getTrajectory() const { return m_states; }
+
+private:
+	double evaluate(const std::vector<control_t>& controls, std::vector<pose_t>& states,
+					const std::vector<pose_t>& reference, const cost_func_t& cost_func) const;
+
+	void computeGradient(const std::vector<pose_t>& reference, const cost_func_t& cost_func);
+
+	void project(std::vector<control_t>& controls) const;
+
+	params_t m_params;
+	control_t m_start_vel;
+	bool m_have_solution = false;
+	double m_step_size = 0.1;
+
+	std::vector<control_t> m_controls;
+	std::vector<control_t> m_candidate;
+	std::vector<control_t> m_gradient;
+	std::vector<pose_t> m_states;			// horizon + 1
+	std::vector<pose_t> m_candidate_states;
+	std::vector<pose_t> m_adjoint;
+
+};
+
+
+} // neo_local_planner
+
+#endif /* INCLUDE_MPCSOLVER_H_ */
@@ -36,6 +36,7 @@
 #define INCLUDE_NEOLOCALPLANNER_H_
 
 #include <tf2_ros/buffer.h>
+#include <tf2/LinearMath/Transform.h>
 // #include <dynamic_reconfigure/server.h>
 #include <angles/angles.h>
 #include "rclcpp/rclcpp.hpp"
@@ -45,6 +46,8 @@
 #include <vector>
 #include <memory>
 #include <algorithm>
+#include <array>
+#include <atomic>
 
 #include "nav2_core/controller.hpp"
 #include "rclcpp/rclcpp.hpp"
@@ -53,9 +56,27 @@
 #include "nav2_util/odometry_utils.hpp"
 #include "geometry_msgs/msg/pose2_d.hpp"
 #include "geometry_msgs/msg/vector3_stamped.hpp"
+#include "std_msgs/msg/u_int64_multi_array.hpp"
+#include "std_msgs/msg/u_int8_multi_array.hpp"
+#include "std_srvs/srv/trigger.hpp"
 #include <boost/shared_ptr.hpp>
 #include <boost/thread.hpp>
 
+#include "AsyncLogger.h"
+#include "FlightRecorder.h"
+#include "WorkerPool.h"
+#include "PlanPreprocessor.h"
+#include "EgoCostGrid.h"
+#include "MpcSolver.h"
+#include "PeriodicTask.h"
+#include "PlanStorage.h"
+#include "ScanTemplates.h"
+#include "SE2.h"
+#include "SeqLock.h"
+#include "SpeedLimitMap.h"
+#include "ThreadPlacement.h"
+#include "VersionedBuffer.h"
+
 
 namespace neo_local_planner {
 
@@ -70,7 +91,7 @@ public:
   /**
    * @brief Destrructor for nav2_regulated_pure_pursuit_controller::RegulatedPurePursuitController
    */
-  ~NeoLocalPlanner() override = default;
+  ~NeoLocalPlanner() override;
 
   /**
    * @brief Configure controller state machine
@@ -84,6 +105,16 @@ public:
     std::string name, const std::shared_ptr<tf2_ros::Buffer> & tf,
     const std::shared_ptr<nav2_costmap_2d::Costmap2DROS> & costmap_ros) override;
 
+	/*
+	 * Same as above, but with a plain costmap owned by the caller, for running without a costmap node
+	 * (see KinematicSimulator). Every cycle treats the whole costmap as updated.
+	 * The footprint is only used by the speed limit map.
+	 */
+	void configure(	const rclcpp_lifecycle::LifecycleNode::SharedPtr & parent,
+					std::string name, const std::shared_ptr<tf2_ros::Buffer> & tf,
+					nav2_costmap_2d::Costmap2D* costmap, const std::string& base_frame,
+					const nav2_costmap_2d::Footprint& footprint = nav2_costmap_2d::Footprint());
+
   /**
    * @brief Cleanup controller state machine
    */
@@ -124,29 +155,283 @@ public:
 	void odomCallback(const nav_msgs::msg::Odometry::SharedPtr msg);
 
 	bool isGoalReached();
+
+	struct batch_item_t {
+		NeoLocalPlanner* planner = 0;
+		geometry_msgs::msg::PoseStamped pose;
+		geometry_msgs::msg::Twist speed;
+		geometry_msgs::msg::TwistStamped cmd_vel;		// output
+	};
+
+	struct batch_stats_t {
+		size_t num_items = 0;
+		int num_threads = 0;
+		double wall_time = 0;			// [s]
+		double cycles_per_core = 0;		// robots x Hz per core [1/s]
+	};
+
+	/*
+	 * Runs one control cycle for every planner in the batch, in parallel on the given pool.
+	 * Meant for fleet simulations which run many planner instances in one process.
+	 */
+	static batch_stats_t computeVelocityCommandsBatch(std::vector<batch_item_t>& batch, WorkerPool& pool);
+
     	
 
 private:
+	struct scan_sample_t {
+		double x = 0;
+		double y = 0;
+		double yaw = 0;
+		double dist = 0;		// arc length from start of scan
+		double cost = 0;		// max cost along segment ending at this sample
+	};
+
+	struct obstacle_scan_t {
+		bool have_obstacle = false;
+		double obstacle_dist = 0;
+		double obstacle_cost = 0;
+	};
+
+	/*
+	 * Scans along the predicted arc for obstacles, starting at given pose.
+	 * Re-uses the previous cycle's samples as long as the new arc stays within
+	 * scan_reuse_tolerance of the old one, only segments which are new or
+	 * touched by the last costmap update are evaluated again.
+	 */
+	obstacle_scan_t scanObstacles(	const SE2& start_pose, double curvature,
+									double delta_move, double max_dist, const EgoCostGrid* ego_grid);
+
+	/*
+	 * Range [reuse_begin, reuse_end) of the last scan's samples which a scan from start_pose can re-use,
+	 * returns false if there is none (disabled, too old or diverged beyond scan_reuse_tolerance).
+	 */
+	bool findScanReuse(const SE2& start_pose, double curvature, size_t& reuse_begin, size_t& reuse_end) const;
+
+	bool isSegmentDirty(const scan_sample_t& a, const scan_sample_t& b) const;
+
+	/*
+	 * Area of the last costmap update in world coords (x0, y0, x1, y1), everything without costmap_ros_.
+	 */
+	void getDirtyBounds(double bounds[4]) const;
+
+	/*
+	 * Scans along the arc given by the start velocities, step and horizon depend on the degradation level.
+	 * Cost queries go through ego_grid where it covers them, if given.
+	 */
+	obstacle_scan_t runObstacleScan(const SE2& start_pose, double start_vel_x, double start_yawrate, int degrade_level,
+									const EgoCostGrid* ego_grid);
+
+	/*
+	 * Same as scanObstacles() but takes the cells from precomputed templates where possible.
+	 * Always a full scan, its samples can be re-used by the next scanObstacles().
+	 * Returns false if no template applies (disabled, curvature out of range, start outside of map).
+	 */
+	bool scanObstaclesTemplated(const SE2& start_pose, double curvature, double max_dist, obstacle_scan_t& result,
+								const EgoCostGrid* ego_grid);
+
+	/*
+	 * Bilinear interpolated costmap cost [0..1] at (x, y) in local frame, gradient in grad[2].
+	 */
+	double sampleCost(double x, double y, double* grad) const;
+
+	/*
+	 * Closest plan index to (x, y) in global frame, see plan_search_window.
+	 */
+	size_t findClosestOnPlan(double x, double y) const;
+
+	void computeMpcControl(	const SE2& start_pose,
+							const SE2& local_to_global,
+							const SE2& global_to_local,
+							double max_trans_vel, double max_rot_vel,
+							double& control_vel_x, double& control_vel_y, double& control_yawrate);
+
+	/*
+	 * Computes cost gradients (x, y, yaw) around given pose, skipped ones keep their value.
+	 */
+	void computeGradients(	const SE2& pose, double cost_y_lookahead_dist,
+							bool skip_xy, bool skip_yaw, double* delta_cost,
+							const EgoCostGrid* ego_grid) const;
+
+	/*
+	 * Input and output of the background perception stage (see perception_rate).
+	 */
+	struct perception_input_t {
+		SE2 pose;						// predicted pose in local frame
+		double start_vel_x = 0;
+		double start_yawrate = 0;
+		double cost_y_lookahead_dist = 0;
+		int degrade_level = 0;
+	};
+
+	struct perception_result_t {
+		rclcpp::Time stamp;				// time when computation started
+		double delta_cost[3] = {};
+		obstacle_scan_t obstacle_scan;
+		std::vector<scan_sample_t> samples;
+	};
+
+	void perceptionUpdate();
+
+	struct local_plan_t {
+		builtin_interfaces::msg::Time stamp;
+		std::vector<scan_sample_t> samples;
+	};
+
+	/*
+	 * Work moved out of the control loop in real_time_mode: TF lookup and publishing.
+	 */
+	void supportUpdate();
+
+	struct odom_sample_t {
+		rclcpp::Time stamp;
+		double x = 0;
+		double y = 0;
+		double yaw = 0;
+	};
+
+	/*
+	 * Interpolates odometry pose at given time, returns false if not covered by the history.
+	 */
+	bool interpolateOdometry(const rclcpp::Time& time, odom_sample_t& sample) const;
+
+	const odom_sample_t& getOdometrySample(size_t i) const;		// 0 = oldest
+
+	/*
+	 * Inputs of the drive model specific part of the control law.
+	 */
+	struct control_input_t {
+		double start_vel_x = 0;
+		double start_yawrate = 0;
+		double pos_error_x = 0;			// target in predicted robot frame
+		double pos_error_y = 0;
+		double yaw_error = 0;
+		double delta_cost_x = 0;
+		double delta_cost_y = 0;
+		double delta_cost_yaw = 0;
+		double max_rot_vel = 0;
+		double obstacle_dist = 0;
+		bool have_obstacle = false;
+		bool is_goal_target = false;
+	};
+
+	/*
+	 * Drive model policies, each provides:
+	 *   static const bool has_lateral_vel;
+	 *   static void apply(NeoLocalPlanner&, const control_input_t&, double& control_vel_x, double& control_vel_y, double& control_yawrate);
+	 *   static bool isStuck(const NeoLocalPlanner&, const control_input_t&);
+	 * apply() gets control_vel_x from the shared longitudinal law and may update m_state.
+	 */
+	struct drive_policy_base_t {
+		static bool isStuck(const NeoLocalPlanner& planner, const control_input_t& in);
+	};
+	struct differential_drive_t;
+	struct holonomic_drive_t;
+
+	/*
+	 * Policy instantiation selected in configure().
+	 */
+	struct drive_model_t {
+		void (*apply)(NeoLocalPlanner&, const control_input_t&, double&, double&, double&) = nullptr;
+		bool (*is_stuck)(const NeoLocalPlanner&, const control_input_t&) = nullptr;
+		bool has_lateral_vel = false;
+	};
+
+	template<typename Drive>
+	static drive_model_t getDriveModel()
+	{
+		drive_model_t model;
+		model.apply = &Drive::apply;
+		model.is_stuck = &Drive::isStuck;
+		model.has_lateral_vel = Drive::has_lateral_vel;
+		return model;
+	}
+
+	struct odom_state_t {
+		double x = 0;
+		double y = 0;
+		double yaw = 0;
+	};
+
+	struct goal_state_t {
+		double x = 0;				// goal pose in local frame
+		double y = 0;
+		double yaw = 0;
+		bool have_plan = false;
+		bool have_goal = false;		// false until we had a transform for the current plan
+	};
+
+	/*
+	 * Transforms goal into local frame and publishes it for isGoalReached().
+	 * Caller must hold m_odometry_mutex, so that m_goal_state has one writer at a time.
+	 */
+	void updateGoal(const SE2& global_to_local);
+
+	/*
+	 * Applies control_thread to the calling thread, once per thread.
+	 * Pool workers and batch callers are not ours to place and are skipped.
+	 * Caller must hold m_odometry_mutex.
+	 */
+	void placeControlThread();
+
+	/*
+	 * Puts the last placed control thread back to its scheduling and affinity from before.
+	 * Caller must hold m_odometry_mutex.
+	 */
+	void restoreControlThread();
+
+	/*
+	 * Degradation levels used when behind cycle_time_budget, each level includes the previous ones.
+	 */
+	enum degrade_level_t {
+		DEGRADE_NONE,
+		DEGRADE_COARSE_SCAN,			// double obstacle scan step
+		DEGRADE_SHORT_SCAN,				// halve obstacle scan horizon (but not below stopping distance)
+		DEGRADE_FEWER_PROBES,			// re-use last yaw cost gradient
+		DEGRADE_REUSE_GRADIENTS,		// re-use all last cost gradients
+		NUM_DEGRADE_LEVELS
+	};
+
+	void updateDegradation(int level, double cycle_time);
+
+	void dumpFlightRecord(dump_reason_t reason);
+
+	void dumpServiceCallback(	const std::shared_ptr<std_srvs::srv::Trigger::Request> request,
+								std::shared_ptr<std_srvs::srv::Trigger::Response> response);
+
+
 	std::shared_ptr<tf2_ros::Buffer> tf_;
 	std::string plugin_name_;
 	std::shared_ptr<nav2_costmap_2d::Costmap2DROS> costmap_ros_;
 	nav2_costmap_2d::Costmap2D * costmap_;
 	rclcpp::Logger logger_ {rclcpp::get_logger("NeoLocalPlanner")};
+	std::shared_ptr<AsyncLogger> m_log;
 	tf2_ros::Buffer* m_tf = 0;
 	nav2_costmap_2d::Costmap2DROS* m_cost_map;
-	nav_msgs::msg::Path m_global_plan;
+	PlanStorage m_global_plan;
+	size_t m_plan_progress = 0;		// index of last target search result
 	rclcpp::Clock::SharedPtr clock_;
 
 
 	boost::mutex m_odometry_mutex;
 	nav_msgs::msg::Odometry::SharedPtr m_odometry;
 
+	std::vector<odom_sample_t> m_odom_history;		// ring buffer
+	size_t m_odom_history_next = 0;
+	size_t m_odom_history_count = 0;
+	SeqLock<odom_state_t> m_odom_state;				// latest odometry pose, lock-free
+	SeqLock<goal_state_t> m_goal_state;				// for isGoalReached(), lock-free
+	double m_pose_latency = 0;		// age of input pose at time of command [s]
+	double m_odom_latency = 0;		// age of latest odometry at time of command [s]
+
 	rclcpp::Subscription<nav_msgs::msg::Odometry>::SharedPtr m_odom_sub;
   std::shared_ptr<rclcpp_lifecycle::LifecyclePublisher<nav_msgs::msg::Path>> m_local_plan_pub;
 
 	std::string m_global_frame = "map";
 	std::string m_local_frame = "odom";
 	std::string m_base_frame = "base_link";
+	std::string m_odom_topic = "/odom";
+	std::string m_local_plan_topic = "/local_plan";
 
 	enum state_t {
 		STATE_IDLE,
@@ -160,13 +445,65 @@ private:
 	state_t m_state = state_t::STATE_IDLE;
 
 	rclcpp::Time m_last_time;
-	rclcpp::Time m_first_goal_reached_time;
-
-	bool m_is_goal_reached = false;
+	// owned by isGoalReached(), read by the control loop
+	std::atomic<int64_t> m_first_goal_reached_time {0};		// [ns]
+	std::atomic<bool> m_is_goal_reached {false};
 	uint64_t m_update_counter = 0;
 	double m_last_control_values[3] = {};
 	geometry_msgs::msg::Twist m_last_cmd_vel;
 
+	std::vector<scan_sample_t> m_scan_samples;
+	std::vector<scan_sample_t> m_scan_buffer;		// next scan, swapped with m_scan_samples
+	std::shared_ptr<const ScanTemplates> m_scan_templates;		// shared with other instances
+	EgoCostGrid m_ego_grid;							// owned by control loop
+	SpeedLimitMap m_speed_map;						// owned by control loop
+	std::vector<uint8_t> m_speed_map_data;			// encoded m_speed_map, owned by control loop
+	drive_model_t m_drive_model;
+	MpcSolver m_mpc;
+	std::vector<MpcSolver::pose_t> m_mpc_reference;
+	std::vector<unsigned char> m_scan_step_costs;
+	double m_scan_curvature = 0;
+	int m_scan_age = 0;
+	double m_dirty_bounds[4] = {};		// last costmap update in world coords (x0, y0, x1, y1)
+
+	std::shared_ptr<FlightRecorder> m_flight_recorder;
+	rclcpp::Service<std_srvs::srv::Trigger>::SharedPtr m_dump_service;
+	bool m_last_emergency_brake = false;
+
+	int m_degrade_level = DEGRADE_NONE;
+	int m_num_fast_cycles = 0;
+	uint64_t m_degrade_counts[NUM_DEGRADE_LEVELS] = {};
+	double m_last_delta_cost[3] = {};
+	bool m_have_gradients = false;
+	std::shared_ptr<rclcpp_lifecycle::LifecyclePublisher<std_msgs::msg::UInt64MultiArray>> m_degrade_pub;
+	std::shared_ptr<rclcpp_lifecycle::LifecyclePublisher<std_msgs::msg::UInt8MultiArray>> m_speed_map_pub;
+
+	std::shared_ptr<WorkerPool> m_stage_pool;		// only set if parallel_stages
+
+	VersionedBuffer<perception_input_t> m_perception_input;
+	VersionedBuffer<perception_result_t> m_perception_output;
+	perception_result_t m_perception;				// latest result used by control loop
+	uint64_t m_perception_version = 0;
+	PeriodicTask m_perception_task;
+	perception_input_t m_perception_work_input;		// owned by perception task
+	perception_result_t m_perception_work_result;	// owned by perception task
+	uint64_t m_perception_input_version = 0;
+
+	PeriodicTask m_support_task;
+	VersionedBuffer<SE2> m_global_to_local;
+	VersionedBuffer<local_plan_t> m_local_plan_output;
+	VersionedBuffer<std::array<uint64_t, NUM_DEGRADE_LEVELS>> m_degrade_counts_output;
+	local_plan_t m_local_plan;						// owned by control loop
+	local_plan_t m_support_local_plan;				// owned by support task
+	uint64_t m_support_local_plan_version = 0;
+	uint64_t m_support_degrade_counts_version = 0;
+	VersionedBuffer<std::vector<uint8_t>> m_speed_map_output;
+	std::vector<uint8_t> m_support_speed_map;		// owned by support task
+	uint64_t m_support_speed_map_version = 0;
+
+	thread_state_t m_control_thread_state;			// control thread before placement, guarded by m_odometry_mutex
+	bool m_is_control_thread_placed = false;
+
 protected:
 	double acc_lim_x = 0;
 	double acc_lim_y = 0;
@@ -214,6 +551,35 @@ protected:
 	double min_stop_dist = 0.0;
 	double emergency_acc_lim_x = 0.0;
 	bool enable_software_stop = false;
+	double scan_reuse_tolerance = 0.0;
+	int scan_refresh_cycles = 0;
+	bool latency_compensation = false;
+	double actuation_delay = 0.0;
+	double max_latency = 0.0;
+	int odom_history_size = 0;
+	preprocess_params_t plan_preprocessing;
+	double log_throttle_period = 0.0;
+	int flight_recorder_size = 0;
+	std::string flight_recorder_file;
+	double cycle_time_budget = 0.0;
+	bool parallel_stages = false;
+	int num_stage_threads = 0;
+	double perception_rate = 0.0;
+	double perception_timeout = 0.5;
+	bool real_time_mode = false;
+	bool scan_templates = false;
+	ScanTemplates::params_t scan_template_params;
+	double plan_search_window = 5.0;
+	double plan_splice_tolerance = 0.01;
+	double plan_splice_yaw_tolerance = 0.01;
+	int ego_grid_size = 0;
+	double speed_map_dist = 0;
+	double speed_map_step = 0.1;
+	int speed_map_refresh_cycles = 10;
+	bool mpc_mode = false;
+	MpcSolver::params_t mpc_params;
+	thread_config_t control_thread;					// thread calling computeVelocityCommands()
+	thread_config_t worker_thread;					// perception, support and stage pool threads
 
 	
 };
@@ -0,0 +1,92 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2016, Neobotix GmbH
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Neobotix nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+#ifndef INCLUDE_PLANPREPROCESSOR_H_
+#define INCLUDE_PLANPREPROCESSOR_H_
+
+#include <vector>
+#include <cstddef>
+
+
+namespace neo_local_planner {
+
+struct plan_point_t {
+	double x = 0;
+	double y = 0;
+	double yaw = 0;
+};
+
+struct preprocess_params_t {
+	double dedupe_dist = 0;				// drop poses closer than this to their predecessor [m]
+	double simplify_tolerance = 0;		// Douglas-Peucker tolerance, 0 = disabled [m]
+	double simplify_max_angle = 0;		// max net heading change replaced by a single segment [rad]
+	double resample_step = 0;			// uniform arc length spacing, 0 = disabled [m]
+};
+
+struct preprocess_stats_t {
+	size_t num_input = 0;
+	size_t num_output = 0;
+	double runtime = 0;					// [s]
+};
+
+/*
+ * Removes consecutive poses closer than min_dist to the last kept one.
+ * The final pose is always kept.
+ */
+std::vector<plan_point_t> dedupe_plan(const std::vector<plan_point_t>& plan, double min_dist);
+
+/*
+ * Douglas-Peucker simplification. In addition to the distance tolerance a span is split
+ * when its net heading change exceeds max_angle, so that turns keep their curvature
+ * even with a coarse tolerance. First and last pose are always kept.
+ */
+std::vector<plan_point_t> simplify_plan(const std::vector<plan_point_t>& plan, double tolerance, double max_angle);
+
+/*
+ * Resamples to uniform arc length spacing, orientation is interpolated.
+ * First and last pose are kept as is.
+ */
+std::vector<plan_point_t> resample_plan(const std::vector<plan_point_t>& plan, double step);
+
+/*
+ * Runs dedupe, simplify and resample, skipping disabled stages.
+ */
+std::vector<plan_point_t> preprocess_plan(	std::vector<plan_point_t> plan,
+											const preprocess_params_t& params,
+											preprocess_stats_t* stats = 0);
+
+
+} // neo_local_planner
+
+#endif /* INCLUDE_PLANPREPROCESSOR_H_ */
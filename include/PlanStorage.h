@@ -0,0 +1,118 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2016, Neobotix GmbH
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Neobotix nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+#ifndef INCLUDE_PLANSTORAGE_H_
+#define INCLUDE_PLANSTORAGE_H_
+
+#include "PlanPreprocessor.h"
+
+#include <vector>
+#include <cstddef>
+
+
+namespace neo_local_planner {
+
+/*
+ * Global plan stored as structure of arrays, about 32 bytes per pose.
+ * All queries are done in the frame of the plan.
+ */
+class PlanStorage {
+public:
+	std::vector<double> x;
+	std::vector<double> y;
+	std::vector<double> yaw;
+	std::vector<double> s;			// cumulative arc length [m]
+
+	struct splice_t {
+		size_t offset = 0;			// old index of first kept prefix pose
+		size_t prefix = 0;			// poses kept from old plan at the front
+		size_t suffix = 0;			// poses kept from old plan at the end
+		size_t old_size = 0;
+	};
+
+	void assign(const std::vector<plan_point_t>& points);
+
+	/*
+	 * Replaces the plan like assign(), but keeps the poses (and their arc lengths) of the old plan
+	 * which match the new one within tolerance [m] and yaw_tolerance [rad].
+	 * The new plan may start anywhere on the old one, the old poses before that are dropped.
+	 * Its start is searched from 0.2 * search_dist before to search_dist after old index 'hint',
+	 * or on the whole old plan if search_dist <= 0.
+	 * Still O(N): matching the kept poses and moving them into place touches all of them, only the
+	 * arc lengths of the kept sections are shifted instead of integrated again.
+	 * Returns false if nothing matched (same as assign()).
+	 */
+	bool splice(const std::vector<plan_point_t>& points, double tolerance, double yaw_tolerance,
+				size_t hint, double search_dist, splice_t* result = 0);
+
+	/*
+	 * Maps an index of the old plan to the new one after splice(), or returns 'fallback' if the
+	 * pose was not kept.
+	 */
+	static size_t mapIndex(const splice_t& splice, size_t new_size, size_t old_index, size_t fallback);
+
+	void clear();
+
+	size_t size() const { return x.size(); }
+
+	bool empty() const { return x.empty(); }
+
+	double length() const { return s.empty() ? 0 : s.back(); }
+
+	/*
+	 * Returns index of point in [begin, end) closest to (px, py).
+	 */
+	size_t findClosest(double px, double py, size_t begin, size_t end, double* actual_dist = 0) const;
+
+	/*
+	 * Like findClosest(), but only searches from dist_back before to dist_ahead after index 'center'.
+	 * Cost depends on the window length, not the plan length.
+	 */
+	size_t findClosestInWindow(	double px, double py, size_t center, double dist_back, double dist_ahead,
+								double* actual_dist = 0) const;
+
+	/*
+	 * Returns first index after begin which is at least dist further along the path,
+	 * or the last index if the path is too short.
+	 */
+	size_t moveAlong(size_t begin, double dist, double* actual_dist = 0) const;
+
+	size_t memoryUsage() const;
+
+};
+
+
+} // neo_local_planner
+
+#endif /* INCLUDE_PLANSTORAGE_H_ */
@@ -0,0 +1,82 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2016, Neobotix GmbH
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Neobotix nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+#ifndef INCLUDE_PRIORITYINHERITMUTEX_H_
+#define INCLUDE_PRIORITYINHERITMUTEX_H_
+
+#include <pthread.h>
+
+
+namespace neo_local_planner {
+
+/*
+ * Mutex with priority inheritance, for state shared between the control thread and
+ * threads of other priorities. While a SCHED_FIFO thread waits, the holder runs at its priority,
+ * so a preempted low priority holder cannot block it indefinitely.
+ * Use with std::lock_guard / std::unique_lock like std::mutex.
+ */
+class PriorityInheritMutex {
+public:
+	PriorityInheritMutex()
+	{
+		pthread_mutexattr_t attr;
+		pthread_mutexattr_init(&attr);
+		pthread_mutexattr_setprotocol(&attr, PTHREAD_PRIO_INHERIT);
+		pthread_mutex_init(&m_mutex, &attr);
+		pthread_mutexattr_destroy(&attr);
+	}
+
+	~PriorityInheritMutex()
+	{
+		pthread_mutex_destroy(&m_mutex);
+	}
+
+	PriorityInheritMutex(const PriorityInheritMutex&) = delete;
+	PriorityInheritMutex& operator=(const PriorityInheritMutex&) = delete;
+
+	void lock() { pthread_mutex_lock(&m_mutex); }
+
+	bool try_lock() { return pthread_mutex_trylock(&m_mutex) == 0; }
+
+	void unlock() { pthread_mutex_unlock(&m_mutex); }
+
+private:
+	pthread_mutex_t m_mutex;
+
+};
+
+
+} // neo_local_planner
+
+#endif /* INCLUDE_PRIORITYINHERITMUTEX_H_ */
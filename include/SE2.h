@@ -0,0 +1,195 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2016, Neobotix GmbH
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Neobotix nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+
+#ifndef INCLUDE_SE2_H_
+#define INCLUDE_SE2_H_
+
+#include <cmath>
+#include <cstddef>
+
+
+namespace neo_local_planner {
+
+/*
+ * Sine and cosine of the same angle, in one call where the C library has it.
+ */
+inline void sin_cos(double angle, double& sin_value, double& cos_value)
+{
+#ifdef __GLIBC__
+	::sincos(angle, &sin_value, &cos_value);
+#else
+	sin_value = ::sin(angle);
+	cos_value = ::cos(angle);
+#endif
+}
+
+/*
+ * Wraps an angle into [-pi, pi], cheap for angles which are at most one turn off.
+ */
+inline double normalize_yaw(double yaw)
+{
+	if(yaw > M_PI) {
+		yaw -= 2 * M_PI;
+	} else if(yaw < -M_PI) {
+		yaw += 2 * M_PI;
+	}
+	if(yaw > M_PI || yaw < -M_PI) {
+		yaw = ::remainder(yaw, 2 * M_PI);
+	}
+	return yaw;
+}
+
+struct point2_t {
+	double x = 0;
+	double y = 0;
+
+	point2_t() = default;
+	point2_t(double x_, double y_) : x(x_), y(y_) {}
+};
+
+struct twist2_t {
+	double vel_x = 0;				// [m/s]
+	double vel_y = 0;
+	double yawrate = 0;				// [rad/s]
+
+	twist2_t() = default;
+	twist2_t(double vel_x_, double vel_y_, double yawrate_) : vel_x(vel_x_), vel_y(vel_y_), yawrate(yawrate_) {}
+};
+
+/*
+ * Planar rigid transform (x, y, yaw), replaces tf2 3D types in the control loop.
+ * Keeps cos / sin of yaw, so that composing and transforming needs no trigonometry.
+ * Yaw is kept in [-pi, pi]. Conversion from and to ROS types is done by the caller.
+ */
+class SE2 {
+public:
+	SE2() = default;
+
+	SE2(double x, double y, double yaw)
+		:	m_x(x), m_y(y), m_yaw(normalize_yaw(yaw))
+	{
+		sin_cos(m_yaw, m_sin, m_cos);
+	}
+
+	double x() const { return m_x; }
+	double y() const { return m_y; }
+	double yaw() const { return m_yaw; }
+	double cosYaw() const { return m_cos; }
+	double sinYaw() const { return m_sin; }
+
+	point2_t position() const { return point2_t(m_x, m_y); }
+
+	/*
+	 * Transforms a point into the parent frame.
+	 */
+	point2_t operator*(const point2_t& point) const
+	{
+		return point2_t(m_x + m_cos * point.x - m_sin * point.y,
+						m_y + m_sin * point.x + m_cos * point.y);
+	}
+
+	/*
+	 * Same as inverse() * point.
+	 */
+	point2_t inverseTransform(const point2_t& point) const
+	{
+		const double dx = point.x - m_x;
+		const double dy = point.y - m_y;
+		return point2_t(m_cos * dx + m_sin * dy, -m_sin * dx + m_cos * dy);
+	}
+
+	SE2 operator*(const SE2& other) const
+	{
+		const point2_t pos = *this * other.position();
+		return SE2(	pos.x, pos.y, normalize_yaw(m_yaw + other.m_yaw),
+					m_cos * other.m_cos - m_sin * other.m_sin,
+					m_sin * other.m_cos + m_cos * other.m_sin);
+	}
+
+	SE2 inverse() const
+	{
+		return SE2(	-m_cos * m_x - m_sin * m_y, m_sin * m_x - m_cos * m_y, -m_yaw, m_cos, -m_sin);
+	}
+
+	/*
+	 * Rotates a vector (no translation).
+	 */
+	point2_t rotate(const point2_t& vec) const
+	{
+		return point2_t(m_cos * vec.x - m_sin * vec.y, m_sin * vec.x + m_cos * vec.y);
+	}
+
+	/*
+	 * Transforms count points given as separate x and y arrays, output may alias input.
+	 */
+	void transform(const double* x, const double* y, double* out_x, double* out_y, size_t count) const
+	{
+		for(size_t i = 0; i < count; ++i)
+		{
+			const double px = x[i];
+			const double py = y[i];
+			out_x[i] = m_x + m_cos * px - m_sin * py;
+			out_y[i] = m_y + m_sin * px + m_cos * py;
+		}
+	}
+
+	/*
+	 * Moves along a constant twist given in the local frame for dt (using second order midpoint method).
+	 */
+	SE2 predict(const twist2_t& twist, double dt) const
+	{
+		const SE2 midpoint(0, 0, m_yaw + twist.yawrate * dt / 2);
+		const point2_t delta = midpoint.rotate(point2_t(twist.vel_x * dt, twist.vel_y * dt));
+		return SE2(m_x + delta.x, m_y + delta.y, m_yaw + twist.yawrate * dt);
+	}
+
+private:
+	SE2(double x, double y, double yaw, double cos_yaw, double sin_yaw)
+		:	m_x(x), m_y(y), m_yaw(yaw), m_cos(cos_yaw), m_sin(sin_yaw)
+	{
+	}
+
+	double m_x = 0;
+	double m_y = 0;
+	double m_yaw = 0;
+	double m_cos = 1;
+	double m_sin = 0;
+
+};
+
+
+} // neo_local_planner
+
+#endif /* INCLUDE_SE2_H_ */
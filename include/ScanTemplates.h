@@ -0,0 +1,116 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2016, Neobotix GmbH
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Neobotix nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+#ifndef INCLUDE_SCANTEMPLATES_H_
+#define INCLUDE_SCANTEMPLATES_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+
+namespace neo_local_planner {
+
+/*
+ * Precomputed grid cells of the obstacle scan arcs.
+ * One template per (curvature, yaw) bin, holding the cell offset of every scan step
+ * relative to the start cell. Only curvatures >= 0 and yaws in [0, pi/2) are stored,
+ * the rest is covered by mirroring and rotating the offsets by multiples of 90 degrees.
+ * Templates end where the binning error could exceed the given tolerance.
+ */
+class ScanTemplates {
+public:
+	struct params_t {
+		double resolution = 0.05;			// costmap resolution [m]
+		double step = 0.05;					// scan step [m]
+		double max_dist = 10;				// scan horizon [m]
+		double max_curvature = 1;			// [1/m]
+		int num_curvature_bins = 101;		// over [0, max_curvature]
+		int num_yaw_bins = 720;				// per full turn, rounded up to a multiple of 4
+		double tolerance = 0.1;				// max lateral error due to binning [m]
+	};
+
+	struct scan_result_t {
+		int num_steps = 0;					// steps evaluated, including the one we stopped at
+		bool have_obstacle = false;			// last step reached stop_cost
+		bool left_map = false;				// last step is outside of the map
+	};
+
+	void build(const params_t& params);
+
+	void clear();
+
+	bool empty() const { return m_offsets.empty(); }
+
+	const params_t& getParams() const { return m_params; }
+
+	int getNumSteps() const { return m_num_steps; }		// per template, step 0 is the start cell
+
+	size_t getNumTemplates() const { return m_num_steps > 0 ? m_offsets.size() / m_num_steps : 0; }
+
+	size_t memoryUsage() const;
+
+	/*
+	 * Walks the template for given yaw and curvature from start cell (mx, my) through a row major char map,
+	 * writing the max cost of each step into step_costs. Stops at the first step reaching stop_cost,
+	 * when leaving the map or after num_steps. Returns false if curvature is outside of the table.
+	 */
+	bool scan(	const unsigned char* costs, int size_x, int size_y, int mx, int my,
+				double yaw, double curvature, int num_steps, int stop_cost,
+				unsigned char* step_costs, scan_result_t& result) const;
+
+	/*
+	 * Process-wide table for the given params, built by the first caller and shared
+	 * by all planner instances using the same params. Freed when the last user releases it.
+	 */
+	static std::shared_ptr<const ScanTemplates> getShared(const params_t& params);
+
+private:
+	struct offset_t {
+		int16_t dx;
+		int16_t dy;
+	};
+
+	params_t m_params;
+	int m_num_steps = 0;
+	int m_yaw_bins_per_quadrant = 0;
+	std::vector<offset_t> m_offsets;		// [curvature bin][yaw bin][step]
+
+};
+
+
+} // neo_local_planner
+
+#endif /* INCLUDE_SCANTEMPLATES_H_ */
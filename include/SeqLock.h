@@ -0,0 +1,112 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2016, Neobotix GmbH
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Neobotix nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+#ifndef INCLUDE_SEQLOCK_H_
+#define INCLUDE_SEQLOCK_H_
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+
+namespace neo_local_planner {
+
+/*
+ * Small value published by a single writer and read lock-free by any number of readers.
+ * Readers retry while a write is in progress, writers never wait.
+ */
+template<typename T>
+class SeqLock {
+	static_assert(std::is_trivially_copyable<T>::value, "SeqLock needs a trivially copyable type");
+
+public:
+	/*
+	 * Must not be called concurrently with itself.
+	 */
+	void write(const T& value)
+	{
+		uint64_t words[num_words] = {};
+		std::memcpy(words, &value, sizeof(T));
+
+		const uint64_t seq = m_seq.load(std::memory_order_relaxed);
+		m_seq.store(seq + 1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+
+		for(size_t i = 0; i < num_words; ++i) {
+			m_words[i].store(words[i], std::memory_order_relaxed);
+		}
+		m_seq.store(seq + 2, std::memory_order_release);
+	}
+
+	/*
+	 * Returns false if nothing was written yet.
+	 */
+	bool read(T& value) const
+	{
+		uint64_t words[num_words];
+		while(true)
+		{
+			const uint64_t seq = m_seq.load(std::memory_order_acquire);
+			if(seq & 1) {
+				continue;
+			}
+			for(size_t i = 0; i < num_words; ++i) {
+				words[i] = m_words[i].load(std::memory_order_relaxed);
+			}
+			std::atomic_thread_fence(std::memory_order_acquire);
+
+			if(m_seq.load(std::memory_order_relaxed) == seq)
+			{
+				if(seq == 0) {
+					return false;
+				}
+				std::memcpy(&value, words, sizeof(T));
+				return true;
+			}
+		}
+	}
+
+private:
+	static const size_t num_words = (sizeof(T) + 7) / 8;
+
+	std::atomic<uint64_t> m_seq {0};
+	std::atomic<uint64_t> m_words[num_words] = {};
+
+};
+
+
+} // neo_local_planner
+
+#endif /* INCLUDE_SEQLOCK_H_ */
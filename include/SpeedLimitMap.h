@@ -0,0 +1,152 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2016, Neobotix GmbH
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Neobotix nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+#ifndef INCLUDE_SPEEDLIMITMAP_H_
+#define INCLUDE_SPEEDLIMITMAP_H_
+
+#include "PlanStorage.h"
+#include "SE2.h"
+
+#include "nav2_costmap_2d/costmap_2d.hpp"
+#include "nav2_costmap_2d/footprint_collision_checker.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+
+namespace neo_local_planner {
+
+/*
+ * Maximum safe speed at stations along the plan ahead of the robot.
+ * Station k sits at arc length k * step of the plan. A station is blocked if the footprint outline
+ * placed there (facing along the plan) touches a lethal cell, or without footprint if the center
+ * cost reaches max_cost (inflation on the outline is no collision). The speed limit of every other station
+ * allows stopping stop_margin before the next blocked one, computed with one backward pass.
+ * Footprint costs are kept while the window moves along the plan, only new stations and
+ * those near the last costmap update are checked again, unless the plan moved in the costmap.
+ * All memory is allocated in configure() and setFootprint().
+ */
+class SpeedLimitMap {
+public:
+	struct params_t {
+		double step = 0.1;				// station spacing [m]
+		double horizon = 0;				// window length ahead of the robot [m], 0 = disabled
+		double max_vel = 0;				// limit without obstacles [m/s]
+		double stop_accel = 0;			// [m/s^2]
+		double stop_margin = 0;			// distance kept to blocked stations [m]
+		double max_cost = 1;			// center cost [0..1] of a blocked station, without footprint only
+		int refresh_cycles = 10;		// check all stations again after this many updates
+	};
+
+	void configure(const params_t& params);
+
+	void clear();
+
+	bool isValid() const { return m_is_valid; }
+
+	void invalidate() { m_is_valid = false; }
+
+	/*
+	 * Footprint in robot frame, an empty one checks the station centers only.
+	 * Allocates, call it outside of the control cycle.
+	 */
+	void setFootprint(const nav2_costmap_2d::Footprint& footprint);
+
+	/*
+	 * Max number of stations, a bound for getNumStations().
+	 */
+	size_t getCapacity() const { return m_speed.size(); }
+
+	size_t getNumStations() const { return m_is_valid ? m_num_stations : 0; }
+
+	/*
+	 * Moves the window to start at plan index 'progress' and refreshes the limits.
+	 * plan_to_map transforms the plan into costmap frame, dirty_bounds (x0, y0, x1, y1)
+	 * is the area of the last costmap update in costmap frame.
+	 */
+	void update(const PlanStorage& plan, size_t progress, const SE2& plan_to_map,
+				nav2_costmap_2d::Costmap2D* costmap, const double dirty_bounds[4]);
+
+	/*
+	 * Speed limit at the station before plan index 'index', max_vel outside of the window.
+	 */
+	double getSpeedLimit(const PlanStorage& plan, size_t index) const;
+
+	/*
+	 * One byte per station from the robot on, in steps of resolution [m/s], saturating at 255.
+	 * Does not allocate if data has getCapacity() reserved.
+	 */
+	void encode(std::vector<uint8_t>& data, double resolution) const;
+
+	/*
+	 * Cost [0..1] of the footprint outline at a pose in costmap frame, the center cost without footprint.
+	 * Same as FootprintCollisionChecker::footprintCostAtPose() / 255, without allocating.
+	 */
+	double computeFootprintCost(nav2_costmap_2d::Costmap2D* costmap, double x, double y, double yaw);
+
+private:
+	void computeStationPose(const PlanStorage& plan, double s, size_t& index, size_t i);
+
+private:
+	params_t m_params;
+	bool m_is_valid = false;
+	int m_age = 0;
+	SE2 m_plan_to_map;
+
+	int64_t m_first_station = 0;	// station number of index 0
+	size_t m_num_stations = 0;
+
+	// per station
+	std::vector<double> m_x;		// plan frame
+	std::vector<double> m_y;
+	std::vector<double> m_yaw;
+	std::vector<double> m_map_x;	// costmap frame
+	std::vector<double> m_map_y;
+	std::vector<double> m_cost;		// footprint cost [0..1]
+	std::vector<double> m_speed;	// [m/s]
+
+	// footprint corners in robot frame and as costmap cells at the station being checked
+	std::vector<double> m_footprint_x;
+	std::vector<double> m_footprint_y;
+	std::vector<unsigned int> m_footprint_cell_x;
+	std::vector<unsigned int> m_footprint_cell_y;
+	double m_footprint_radius = 0;
+
+};
+
+
+} // neo_local_planner
+
+#endif /* INCLUDE_SPEEDLIMITMAP_H_ */
@@ -0,0 +1,109 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2016, Neobotix GmbH
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Neobotix nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+#ifndef INCLUDE_THREADPLACEMENT_H_
+#define INCLUDE_THREADPLACEMENT_H_
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include <pthread.h>
+#include <sched.h>
+#include <sys/types.h>
+
+
+namespace neo_local_planner {
+
+/*
+ * Execution context of a thread, the default leaves everything unchanged.
+ */
+struct thread_config_t {
+	std::vector<int> cpus;			// allowed CPUs, empty = any
+	int priority = 0;				// SCHED_FIFO priority [1, 99], 0 = keep normal scheduling
+	size_t prefault_stack = 0;		// stack bytes to touch when the thread starts
+
+	bool isDefault() const { return cpus.empty() && priority <= 0 && prefault_stack == 0; }
+};
+
+/*
+ * Scheduling and CPU affinity of a thread as it was before placing it, see save_thread_state().
+ */
+struct thread_state_t {
+	pid_t tid = 0;					// kernel thread id, 0 = nothing saved
+	int policy = SCHED_OTHER;
+	sched_param param = {};
+	cpu_set_t cpus;
+};
+
+/*
+ * Parses a CPU list like "2,3" or "4-7", an empty list gives no CPUs.
+ * cpus is only modified on success.
+ */
+bool parse_cpu_list(const std::string& list, std::vector<int>& cpus, std::string& error);
+
+/*
+ * Sets CPU affinity and scheduling of the given thread, can be called from any thread.
+ * Does not prefault, see prefault_stack(). Returns false if any part failed.
+ * SCHED_FIFO needs CAP_SYS_NICE or a matching RLIMIT_RTPRIO.
+ */
+bool apply_thread_config(pthread_t thread, const thread_config_t& config, std::string& error);
+
+/*
+ * Kernel id of the calling thread, cached per thread.
+ */
+pid_t get_thread_id();
+
+/*
+ * Saves scheduling and affinity of the calling thread, to undo apply_thread_config() later.
+ */
+bool save_thread_state(thread_state_t& state, std::string& error);
+
+/*
+ * Puts a thread back into a state from save_thread_state(), can be called from any thread.
+ * The thread is addressed by kernel id, one which has exited in the meantime is not an error.
+ */
+bool restore_thread_state(const thread_state_t& state, std::string& error);
+
+/*
+ * Touches size bytes of the calling thread's stack, so the pages are mapped
+ * (and locked, after mlockall()) before the first cycle needs them.
+ * Clamped to the stack left below the caller minus a safety margin, returns the bytes touched.
+ */
+size_t prefault_stack(size_t size);
+
+
+} // neo_local_planner
+
+#endif /* INCLUDE_THREADPLACEMENT_H_ */
@@ -0,0 +1,103 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2016, Neobotix GmbH
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Neobotix nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+#ifndef INCLUDE_VERSIONEDBUFFER_H_
+#define INCLUDE_VERSIONEDBUFFER_H_
+
+#include "PriorityInheritMutex.h"
+
+#include <cstdint>
+#include <mutex>
+
+
+namespace neo_local_planner {
+
+/*
+ * Single value shared between threads, tagged with a version that increases on every write.
+ * Readers only copy the value if it changed since the version they already have.
+ * The value may own memory (vectors), so copies happen under a priority inheritance mutex.
+ */
+template<typename T>
+class VersionedBuffer {
+public:
+	/*
+	 * Stores a new value, returns its version (first write is version 1).
+	 */
+	uint64_t write(const T& value)
+	{
+		std::lock_guard<PriorityInheritMutex> lock(m_mutex);
+		m_value = value;
+		return ++m_version;
+	}
+
+	/*
+	 * Copies the value into 'value' if its version is newer than 'known_version'.
+	 * Returns the current version, 0 if nothing was written yet.
+	 */
+	uint64_t read(T& value, uint64_t known_version = 0) const
+	{
+		std::lock_guard<PriorityInheritMutex> lock(m_mutex);
+		if(m_version > known_version) {
+			value = m_value;
+		}
+		return m_version;
+	}
+
+	uint64_t getVersion() const
+	{
+		std::lock_guard<PriorityInheritMutex> lock(m_mutex);
+		return m_version;
+	}
+
+	/*
+	 * Resets the version to 0, the initial value can be used to preallocate storage.
+	 */
+	void clear(const T& value = T())
+	{
+		std::lock_guard<PriorityInheritMutex> lock(m_mutex);
+		m_value = value;
+		m_version = 0;
+	}
+
+private:
+	mutable PriorityInheritMutex m_mutex;
+	T m_value = T();
+	uint64_t m_version = 0;
+
+};
+
+
+} // neo_local_planner
+
+#endif /* INCLUDE_VERSIONEDBUFFER_H_ */
@@ -0,0 +1,127 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2016, Neobotix GmbH
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Neobotix nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+#ifndef INCLUDE_WORKERPOOL_H_
+#define INCLUDE_WORKERPOOL_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "ThreadPlacement.h"
+
+
+namespace neo_local_planner {
+
+/*
+ * Persistent work-stealing thread pool.
+ * Every worker owns a task queue, tasks submitted from a worker go to its own queue,
+ * idle workers steal from the others. Threads calling parallelFor() help out
+ * until their batch is done, so nested use from inside a task does not deadlock.
+ */
+class WorkerPool {
+public:
+	typedef std::function<void()> task_t;
+
+	/*
+	 * num_threads == 0 selects std::thread::hardware_concurrency().
+	 * All workers share the given placement, see getConfigError().
+	 */
+	explicit WorkerPool(int num_threads = 0, const thread_config_t& config = thread_config_t());
+
+	~WorkerPool();
+
+	WorkerPool(const WorkerPool&) = delete;
+	WorkerPool& operator=(const WorkerPool&) = delete;
+
+	int numThreads() const { return int(m_threads.size()); }
+
+	/*
+	 * Why the thread placement failed, empty if it did not.
+	 */
+	const std::string& getConfigError() const { return m_config_error; }
+
+	void submit(task_t task);
+
+	/*
+	 * Calls func(i) for i in [0, count) and returns once all calls are done.
+	 * The first exception thrown by any call is re-thrown here.
+	 */
+	void parallelFor(size_t count, const std::function<void(size_t)>& func);
+
+	/*
+	 * Process-wide pool shared by all planner instances.
+	 * num_threads and config are only used by the first call, later calls get the running pool
+	 * and an error message if they asked for something else.
+	 */
+	static std::shared_ptr<WorkerPool> getShared(int num_threads, const thread_config_t& config, std::string& error);
+
+	/*
+	 * True when called from a worker of any pool.
+	 */
+	static bool isWorkerThread();
+
+private:
+	struct queue_t {
+		std::mutex mutex;
+		std::deque<task_t> tasks;
+	};
+
+	bool tryPop(task_t& task);
+
+	void workerMain(int index, size_t prefault_stack_size);
+
+	std::vector<std::unique_ptr<queue_t>> m_queues;
+	std::vector<std::thread> m_threads;
+	thread_config_t m_config;
+	std::string m_config_error;
+
+	std::mutex m_mutex;
+	std::condition_variable m_condition;
+	std::atomic<size_t> m_num_queued {0};		// modified under the lock of the queue holding the task
+	std::atomic<size_t> m_next_queue {0};
+	bool m_do_run = true;
+
+};
+
+
+} // neo_local_planner
+
+#endif /* INCLUDE_WORKERPOOL_H_ */
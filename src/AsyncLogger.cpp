@@ -0,0 +1,264 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2016, Neobotix GmbH
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Neobotix nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+#include "../include/AsyncLogger.h"
+
+#include <rcutils/logging.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdarg>
+#include <cstdio>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+namespace neo_local_planner {
+
+/*
+ * Process-wide background thread, drains all registered loggers every 10 ms.
+ */
+class AsyncLogger::DrainThread {
+public:
+	DrainThread()
+	{
+		m_thread = std::thread(&DrainThread::run, this);
+	}
+
+	~DrainThread()
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_do_run = false;
+		}
+		m_thread.join();
+	}
+
+	void add(AsyncLogger* logger)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_loggers.push_back(logger);
+	}
+
+	/*
+	 * Once this returns the thread does not touch the logger anymore.
+	 */
+	void remove(AsyncLogger* logger)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_loggers.erase(std::remove(m_loggers.begin(), m_loggers.end(), logger), m_loggers.end());
+	}
+
+	static std::shared_ptr<DrainThread> getShared()
+	{
+		static std::mutex mutex;
+		static std::weak_ptr<DrainThread> instance;
+
+		std::lock_guard<std::mutex> lock(mutex);
+		auto thread = instance.lock();
+		if(!thread) {
+			thread = std::make_shared<DrainThread>();
+			instance = thread;
+		}
+		return thread;
+	}
+
+private:
+	void run()
+	{
+		while(true)
+		{
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				if(!m_do_run) {
+					break;
+				}
+				for(AsyncLogger* logger : m_loggers) {
+					logger->updateLevel();
+					logger->drain();
+				}
+			}
+			std::this_thread::sleep_for(std::chrono::milliseconds(10));
+		}
+	}
+
+	std::mutex m_mutex;
+	std::vector<AsyncLogger*> m_loggers;
+	bool m_do_run = true;
+	std::thread m_thread;
+
+};
+
+AsyncLogger::AsyncLogger(const rclcpp::Logger& logger, size_t capacity)
+	:	m_logger(logger),
+		m_entries(new entry_t[capacity]),
+		m_capacity(capacity)
+{
+	for(size_t i = 0; i < m_capacity; ++i) {
+		m_entries[i].sequence = i;
+	}
+	updateLevel();
+
+	m_drain_thread = DrainThread::getShared();
+	m_drain_thread->add(this);
+}
+
+AsyncLogger::~AsyncLogger()
+{
+	m_drain_thread->remove(this);
+	drain();
+}
+
+void AsyncLogger::updateLevel()
+{
+	static const int severity[] = {
+		RCUTILS_LOG_SEVERITY_DEBUG, RCUTILS_LOG_SEVERITY_INFO, RCUTILS_LOG_SEVERITY_WARN, RCUTILS_LOG_SEVERITY_ERROR
+	};
+	int level = LEVEL_DEBUG;
+	while(level <= LEVEL_ERROR && !rcutils_logging_logger_is_enabled_for(m_logger.get_name(), severity[level])) {
+		level++;
+	}
+	m_min_level.store(level, std::memory_order_relaxed);
+}
+
+void AsyncLogger::log(level_t level, const char* format, ...)
+{
+	if(!isEnabled(level)) {
+		return;
+	}
+	va_list args;
+	va_start(args, format);
+	push(level, 0, format, args);
+	va_end(args);
+}
+
+void AsyncLogger::logThrottled(double period, level_t level, const char* format, ...)
+{
+	if(!isEnabled(level)) {
+		return;
+	}
+	const int64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+							std::chrono::steady_clock::now().time_since_epoch()).count();
+
+	// find slot for this message, keyed by address of format string
+	throttle_t* throttle = 0;
+	const size_t hash = (reinterpret_cast<uintptr_t>(format) >> 3) % num_throttles;
+	for(size_t i = 0; i < num_throttles; ++i)
+	{
+		throttle_t& slot = m_throttles[(hash + i) % num_throttles];
+		const char* expected = 0;
+		if(slot.format == format || slot.format.compare_exchange_strong(expected, format) || expected == format) {
+			throttle = &slot;
+			break;
+		}
+	}
+
+	uint64_t num_suppressed = 0;
+	if(throttle)
+	{
+		int64_t last_time = throttle->last_time;
+		if((last_time != 0 && now - last_time < int64_t(period * 1e9))
+			|| !throttle->last_time.compare_exchange_strong(last_time, now))
+		{
+			throttle->num_suppressed++;
+			return;
+		}
+		num_suppressed = throttle->num_suppressed.exchange(0);
+	}
+
+	va_list args;
+	va_start(args, format);
+	push(level, num_suppressed, format, args);
+	va_end(args);
+}
+
+void AsyncLogger::push(level_t level, uint64_t num_suppressed, const char* format, va_list args)
+{
+	// bounded MPMC queue (D. Vyukov)
+	size_t pos = m_write_pos.load(std::memory_order_relaxed);
+	entry_t* entry = 0;
+	while(true)
+	{
+		entry = &m_entries[pos % m_capacity];
+		const size_t sequence = entry->sequence.load(std::memory_order_acquire);
+		const intptr_t diff = intptr_t(sequence) - intptr_t(pos);
+		if(diff == 0) {
+			if(m_write_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+				break;
+			}
+		} else if(diff < 0) {
+			m_num_dropped++;		// full
+			return;
+		} else {
+			pos = m_write_pos.load(std::memory_order_relaxed);
+		}
+	}
+
+	entry->level = level;
+	int length = ::vsnprintf(entry->text, max_length, format, args);
+	if(num_suppressed > 0 && length >= 0 && size_t(length) < max_length) {
+		::snprintf(entry->text + length, max_length - length, " (suppressed %lu times)", (unsigned long)num_suppressed);
+	}
+	entry->sequence.store(pos + 1, std::memory_order_release);
+}
+
+void AsyncLogger::drain()
+{
+	while(true)
+	{
+		const size_t pos = m_read_pos.load(std::memory_order_relaxed);
+		entry_t& entry = m_entries[pos % m_capacity];
+		if(entry.sequence.load(std::memory_order_acquire) != pos + 1) {
+			break;
+		}
+		switch(entry.level) {
+			case LEVEL_DEBUG: RCLCPP_DEBUG(m_logger, "%s", entry.text); break;
+			case LEVEL_INFO: RCLCPP_INFO(m_logger, "%s", entry.text); break;
+			case LEVEL_WARN: RCLCPP_WARN(m_logger, "%s", entry.text); break;
+			case LEVEL_ERROR: RCLCPP_ERROR(m_logger, "%s", entry.text); break;
+		}
+		m_read_pos.store(pos + 1, std::memory_order_relaxed);
+		entry.sequence.store(pos + m_capacity, std::memory_order_release);
+	}
+
+	const uint64_t num_dropped = m_num_dropped;
+	if(num_dropped != m_num_dropped_reported) {
+		RCLCPP_WARN(m_logger, "AsyncLogger: dropped %lu messages", (unsigned long)(num_dropped - m_num_dropped_reported));
+		m_num_dropped_reported = num_dropped;
+	}
+}
+
+
+} // neo_local_planner
@@ -0,0 +1,166 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2016, Neobotix GmbH
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Neobotix nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+
+#include "../include/EgoCostGrid.h"
+
+#include "nav2_util/line_iterator.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+
+namespace neo_local_planner {
+
+void EgoCostGrid::configure(int size, double resolution)
+{
+	clear();
+	if(size <= 0 || resolution <= 0) {
+		return;
+	}
+	m_size = size;
+	m_resolution = resolution;
+	m_costs.resize(size_t(size) * size);
+}
+
+void EgoCostGrid::clear()
+{
+	m_size = 0;
+	m_resolution = 0;
+	m_is_valid = false;
+	m_costs.clear();
+	m_costs.shrink_to_fit();
+}
+
+void EgoCostGrid::update(	const unsigned char* costs, int size_x, int size_y,
+							double origin_x, double origin_y, double resolution,
+							double x, double y, double yaw)
+{
+	m_is_valid = false;
+	if(m_size <= 0 || size_x < 3 || size_y < 3 || resolution <= 0) {
+		return;
+	}
+	m_x = x;
+	m_y = y;
+	m_cos_yaw = cos(yaw);
+	m_sin_yaw = sin(yaw);
+
+	// grid axes in map cells
+	const double scale = m_resolution / resolution;
+	const float step_x[2] = {float(m_cos_yaw * scale), float(m_sin_yaw * scale)};
+	const float step_y[2] = {float(-m_sin_yaw * scale), float(m_cos_yaw * scale)};
+	const double first_x = -(m_size / 4) + 0.5;
+	const double first_y = -(m_size / 2) + 0.5;
+	const float base[2] = {
+			float((x - origin_x) / resolution + first_x * step_x[0] + first_y * step_y[0]),
+			float((y - origin_y) / resolution + first_x * step_x[1] + first_y * step_y[1])};
+	const int max_x = size_x - 2;
+	const int max_y = size_y - 2;
+	const size_t stride = size_x;
+
+	for(int j = 0; j < m_size; ++j)
+	{
+		const float row_x = base[0] + j * step_y[0];
+		const float row_y = base[1] + j * step_y[1];
+		unsigned char* out = &m_costs[size_t(j) * m_size];
+
+		// branch free, so the compiler can vectorize everything but the gather
+		for(int i = 0; i < m_size; ++i)
+		{
+			const int mx = std::min(std::max(int(std::floor(row_x + i * step_x[0])), 1), max_x);
+			const int my = std::min(std::max(int(std::floor(row_y + i * step_x[1])), 1), max_y);
+			const unsigned char* cell = costs + size_t(my) * stride + mx;
+			const unsigned char* prev = cell - stride;
+			const unsigned char* next = cell + stride;
+			out[i] = std::max(	std::max(std::max(prev[-1], prev[0]), std::max(prev[1], cell[-1])),
+								std::max(std::max(cell[0], cell[1]), std::max(std::max(next[-1], next[0]), next[1])));
+		}
+	}
+	m_is_valid = true;
+}
+
+bool EgoCostGrid::toCell(double x, double y, int& cx, int& cy) const
+{
+	const double dx = x - m_x;
+	const double dy = y - m_y;
+	const double gx = (m_cos_yaw * dx + m_sin_yaw * dy) / m_resolution;
+	const double gy = (-m_sin_yaw * dx + m_cos_yaw * dy) / m_resolution;
+	cx = int(std::floor(gx)) + m_size / 4;
+	cy = int(std::floor(gy)) + m_size / 2;
+	return m_is_valid && cx >= 0 && cx < m_size && cy >= 0 && cy < m_size;
+}
+
+bool EgoCostGrid::getCost(double x, double y, unsigned char& cost) const
+{
+	int cx = 0;
+	int cy = 0;
+	if(!toCell(x, y, cx, cy)) {
+		return false;
+	}
+	cost = m_costs[size_t(cy) * m_size + cx];
+	return true;
+}
+
+bool EgoCostGrid::getMaxLineCost(double x0, double y0, double x1, double y1, double& cost) const
+{
+	int cell[2][2] = {};
+	if(!toCell(x0, y0, cell[0][0], cell[0][1]) || !toCell(x1, y1, cell[1][0], cell[1][1])) {
+		return false;
+	}
+	int max_cost = 0;
+	for(nav2_util::LineIterator line(cell[0][0], cell[0][1], cell[1][0], cell[1][1]); line.isValid(); line.advance()) {
+		max_cost = std::max(max_cost, int(m_costs[size_t(line.getY()) * m_size + line.getX()]));
+	}
+	cost = max_cost / 255.;
+	return true;
+}
+
+bool EgoCostGrid::getAvgLineCost(double x0, double y0, double x1, double y1, double& cost) const
+{
+	int cell[2][2] = {};
+	if(!toCell(x0, y0, cell[0][0], cell[0][1]) || !toCell(x1, y1, cell[1][0], cell[1][1])) {
+		return false;
+	}
+	int sum = 0;
+	int num_cells = 0;
+	for(nav2_util::LineIterator line(cell[0][0], cell[0][1], cell[1][0], cell[1][1]); line.isValid(); line.advance()) {
+		sum += m_costs[size_t(line.getY()) * m_size + line.getX()];
+		num_cells++;
+	}
+	cost = sum / (255. * num_cells);
+	return true;
+}
+
+
+} // neo_local_planner
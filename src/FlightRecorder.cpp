@@ -0,0 +1,128 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2016, Neobotix GmbH
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Neobotix nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+#include "../include/FlightRecorder.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+
+namespace neo_local_planner {
+
+FlightRecorder::FlightRecorder(size_t capacity, const std::string& file_path)
+	:	m_records(new flight_record_t[capacity > 0 ? capacity : 1]),
+		m_capacity(capacity > 0 ? capacity : 1),
+		m_file_path(file_path)
+{
+	::memset(m_records.get(), 0, m_capacity * sizeof(flight_record_t));
+
+	m_slot_size = sizeof(flight_record_header_t) + m_capacity * sizeof(flight_record_t);
+	m_mapping_size = NUM_DUMP_REASONS * m_slot_size;
+	m_fd = ::open(m_file_path.c_str(), O_RDWR | O_CREAT, 0644);
+	if(m_fd < 0) {
+		return;
+	}
+	if(::ftruncate(m_fd, m_mapping_size) != 0) {
+		::close(m_fd);
+		m_fd = -1;
+		return;
+	}
+	void* mapping = ::mmap(0, m_mapping_size, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0);
+	if(mapping == MAP_FAILED) {
+		::close(m_fd);
+		m_fd = -1;
+		return;
+	}
+	m_mapping = mapping;
+
+	// touch all pages now, so that a dump does not fault (keeping the last dump intact)
+	volatile char* data = static_cast<volatile char*>(m_mapping);
+	const size_t page_size = ::sysconf(_SC_PAGESIZE);
+	for(size_t i = 0; i < m_mapping_size; i += page_size) {
+		data[i] = data[i];
+	}
+}
+
+FlightRecorder::~FlightRecorder()
+{
+	if(m_mapping) {
+		::msync(m_mapping, m_mapping_size, MS_SYNC);
+		::munmap(m_mapping, m_mapping_size);
+	}
+	if(m_fd >= 0) {
+		::close(m_fd);
+	}
+}
+
+void FlightRecorder::add(const flight_record_t& record)
+{
+	m_records[m_head] = record;
+	m_head = (m_head + 1) % m_capacity;
+	if(m_count < m_capacity) {
+		m_count++;
+	}
+}
+
+bool FlightRecorder::dump(dump_reason_t reason)
+{
+	if(!m_mapping || reason >= NUM_DUMP_REASONS) {
+		return false;
+	}
+	char* const data = static_cast<char*>(m_mapping) + reason * m_slot_size;
+	flight_record_t* const records = reinterpret_cast<flight_record_t*>(data + sizeof(flight_record_header_t));
+
+	// copy oldest first
+	const size_t first = (m_head + m_capacity - m_count) % m_capacity;
+	const size_t num_tail = std::min(m_count, m_capacity - first);
+	::memcpy(records, &m_records[first], num_tail * sizeof(flight_record_t));
+	::memcpy(records + num_tail, &m_records[0], (m_count - num_tail) * sizeof(flight_record_t));
+
+	flight_record_header_t header;
+	::memcpy(header.magic, flight_record_magic, sizeof(header.magic));
+	header.version = flight_record_version;
+	header.record_size = sizeof(flight_record_t);
+	header.capacity = m_capacity;
+	header.num_records = m_count;
+	header.reason = reason;
+	header.dump_count = ++m_dump_count;
+	::memcpy(data, &header, sizeof(header));
+	return true;
+}
+
+
+} // neo_local_planner
@@ -0,0 +1,444 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2016, Neobotix GmbH
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Neobotix nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+
+#include "../include/KinematicSimulator.h"
+
+#include <rcl/time.h>
+#include <tf2/LinearMath/Quaternion.h>
+#include <tf2_geometry_msgs/tf2_geometry_msgs.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <sstream>
+
+
+namespace neo_local_planner {
+
+// simulated time starts here, so that stamps are never zero
+static const int64_t sim_time_offset = 1000000000;
+
+static geometry_msgs::msg::Quaternion yaw_to_msg(double yaw)
+{
+	tf2::Quaternion q;
+	q.setRPY(0, 0, yaw);
+	return tf2::toMsg(q);
+}
+
+bool load_scenario(const std::string& file_name, sim_scenario_t& scenario, std::string& error)
+{
+	std::ifstream file(file_name);
+	if(!file) {
+		error = "failed to open " + file_name;
+		return false;
+	}
+	scenario = sim_scenario_t();
+	scenario.name = file_name;
+
+	std::string line;
+	for(int line_number = 1; std::getline(file, line); ++line_number)
+	{
+		line = line.substr(0, line.find('#'));
+		std::istringstream in(line);
+		std::string key;
+		if(!(in >> key)) {
+			continue;
+		}
+		bool is_valid = true;
+		if(key == "name") {
+			is_valid = bool(in >> scenario.name);
+		} else if(key == "map") {
+			is_valid = bool(in >> scenario.size_x >> scenario.size_y >> scenario.resolution >> scenario.origin_x >> scenario.origin_y)
+						&& scenario.size_x > 0 && scenario.size_y > 0 && scenario.resolution > 0;
+		} else if(key == "robot") {
+			is_valid = bool(in >> scenario.robot_radius >> scenario.inflation_radius >> scenario.cost_scaling);
+		} else if(key == "start") {
+			is_valid = bool(in >> scenario.start[0] >> scenario.start[1] >> scenario.start[2]);
+		} else if(key == "goal") {
+			is_valid = bool(in >> scenario.goal[0] >> scenario.goal[1] >> scenario.goal[2]);
+		} else if(key == "waypoint") {
+			std::array<double, 2> point;
+			is_valid = bool(in >> point[0] >> point[1]);
+			scenario.waypoints.push_back(point);
+		} else if(key == "obstacle") {
+			sim_obstacle_t obstacle;
+			is_valid = bool(in >> obstacle.x0 >> obstacle.y0 >> obstacle.x1 >> obstacle.y1);
+			if(in >> obstacle.vel_x) {
+				is_valid = is_valid && bool(in >> obstacle.vel_y);
+				if(in >> obstacle.begin_time) {
+					in >> obstacle.end_time;
+				}
+			}
+			if(obstacle.x0 > obstacle.x1) {
+				std::swap(obstacle.x0, obstacle.x1);
+			}
+			if(obstacle.y0 > obstacle.y1) {
+				std::swap(obstacle.y0, obstacle.y1);
+			}
+			scenario.obstacles.push_back(obstacle);
+		} else if(key == "timeout") {
+			is_valid = bool(in >> scenario.timeout);
+		} else {
+			is_valid = false;
+		}
+		if(!is_valid) {
+			error = file_name + ":" + std::to_string(line_number) + ": invalid '" + key + "'";
+			return false;
+		}
+	}
+	return true;
+}
+
+KinematicSimulator::KinematicSimulator(	const sim_scenario_t& scenario, const sim_params_t& params,
+										const std::string& node_name, const rclcpp::NodeOptions& options)
+	:	m_scenario(scenario),
+		m_params(params),
+		m_generator(params.seed),
+		m_noise(0, 1)
+{
+	m_node = std::make_shared<rclcpp_lifecycle::LifecycleNode>(node_name, options);
+
+	// planner takes its time from the node clock
+	rcl_enable_ros_time_override(m_node->get_clock()->get_clock_handle());
+	setTime(0);
+
+	// map and odom coincide
+	m_tf = std::make_shared<tf2_ros::Buffer>(m_node->get_clock());
+	{
+		geometry_msgs::msg::TransformStamped transform;
+		transform.header.stamp = m_node->get_clock()->now();
+		transform.header.frame_id = "map";
+		transform.child_frame_id = "odom";
+		transform.transform.rotation.w = 1;
+		m_tf->setTransform(transform, "simulator", true);
+	}
+
+	// inflation as done by nav2 inflation layer
+	const double resolution = m_scenario.resolution;
+	m_inflation_cells = int(std::ceil(m_scenario.inflation_radius / resolution));
+	{
+		const int width = 2 * m_inflation_cells + 1;
+		m_inflation_kernel.resize(width * width);
+		for(int dy = -m_inflation_cells; dy <= m_inflation_cells; ++dy) {
+			for(int dx = -m_inflation_cells; dx <= m_inflation_cells; ++dx)
+			{
+				const double dist = ::hypot(dx, dy) * resolution;
+				unsigned char cost = nav2_costmap_2d::FREE_SPACE;
+				if(dx == 0 && dy == 0) {
+					cost = nav2_costmap_2d::LETHAL_OBSTACLE;
+				} else if(dist <= m_scenario.robot_radius) {
+					cost = nav2_costmap_2d::INSCRIBED_INFLATED_OBSTACLE;
+				} else if(dist <= m_scenario.inflation_radius) {
+					cost = (unsigned char)(::round((nav2_costmap_2d::INSCRIBED_INFLATED_OBSTACLE - 1)
+										* exp(-m_scenario.cost_scaling * (dist - m_scenario.robot_radius))));
+				}
+				m_inflation_kernel[(dy + m_inflation_cells) * width + dx + m_inflation_cells] = cost;
+			}
+		}
+	}
+
+	m_costmap = std::make_shared<nav2_costmap_2d::Costmap2D>(
+			(unsigned int)(std::ceil(m_scenario.size_x / resolution)), (unsigned int)(std::ceil(m_scenario.size_y / resolution)),
+			resolution, m_scenario.origin_x, m_scenario.origin_y, nav2_costmap_2d::FREE_SPACE);
+
+	// static obstacles are drawn once
+	m_static_costs.assign(size_t(m_costmap->getSizeInCellsX()) * m_costmap->getSizeInCellsY(), nav2_costmap_2d::FREE_SPACE);
+	for(const auto& obstacle : m_scenario.obstacles)
+	{
+		if(obstacle.vel_x == 0 && obstacle.vel_y == 0 && obstacle.begin_time <= 0 && std::isinf(obstacle.end_time)) {
+			rasterize(obstacle, 0, 0, m_static_costs.data());
+		}
+	}
+	updateCostmap();
+
+	m_planner = std::make_shared<NeoLocalPlanner>();
+	m_planner->configure(m_node, m_params.plugin_name, m_tf, m_costmap.get(), "base_link");
+	m_planner->activate();
+
+	// straight segments from start via waypoints to goal, one pose per cell
+	{
+		std::vector<std::array<double, 2>> corners;
+		corners.push_back({m_scenario.start[0], m_scenario.start[1]});
+		corners.insert(corners.end(), m_scenario.waypoints.begin(), m_scenario.waypoints.end());
+		corners.push_back({m_scenario.goal[0], m_scenario.goal[1]});
+
+		std::vector<plan_point_t> points;
+		for(size_t i = 0; i + 1 < corners.size(); ++i)
+		{
+			const double delta_x = corners[i + 1][0] - corners[i][0];
+			const double delta_y = corners[i + 1][1] - corners[i][1];
+			const int num_steps = std::max(int(::hypot(delta_x, delta_y) / resolution), 1);
+			for(int k = 0; k < num_steps; ++k)
+			{
+				plan_point_t point;
+				point.x = corners[i][0] + delta_x * k / num_steps;
+				point.y = corners[i][1] + delta_y * k / num_steps;
+				point.yaw = ::atan2(delta_y, delta_x);
+				points.push_back(point);
+			}
+		}
+		plan_point_t goal;
+		goal.x = m_scenario.goal[0];
+		goal.y = m_scenario.goal[1];
+		goal.yaw = m_scenario.goal[2];
+		points.push_back(goal);
+
+		nav_msgs::msg::Path path;
+		path.header.stamp = m_node->get_clock()->now();
+		path.header.frame_id = "map";
+		path.poses.resize(points.size());
+		for(size_t i = 0; i < points.size(); ++i)
+		{
+			path.poses[i].header = path.header;
+			path.poses[i].pose.position.x = points[i].x;
+			path.poses[i].pose.position.y = points[i].y;
+			path.poses[i].pose.orientation = yaw_to_msg(points[i].yaw);
+		}
+		m_plan.assign(points);
+		m_planner->setPlan(path);
+	}
+
+	for(int i = 0; i < 3; ++i) {
+		m_pose[i] = m_scenario.start[i];
+	}
+	m_result.name = m_scenario.name;
+	m_result.min_clearance = max_clearance;
+}
+
+KinematicSimulator::~KinematicSimulator()
+{
+	m_planner->deactivate();
+	m_planner->cleanup();
+	m_planner.reset();
+}
+
+bool KinematicSimulator::step()
+{
+	if(m_is_done) {
+		return false;
+	}
+	const auto step_begin = std::chrono::steady_clock::now();
+
+	updateCostmap();
+
+	// odometry with noise, fed directly instead of via topic
+	auto odom = std::make_shared<nav_msgs::msg::Odometry>();
+	odom->header.stamp = m_node->get_clock()->now();
+	odom->header.frame_id = "odom";
+	odom->child_frame_id = "base_link";
+	odom->pose.pose.position.x = m_pose[0] + m_params.odom_noise_pos * m_noise(m_generator);
+	odom->pose.pose.position.y = m_pose[1] + m_params.odom_noise_pos * m_noise(m_generator);
+	odom->pose.pose.orientation = yaw_to_msg(m_pose[2] + m_params.odom_noise_yaw * m_noise(m_generator));
+	odom->twist.twist.linear.x = m_vel[0] + m_params.odom_noise_vel * m_noise(m_generator);
+	odom->twist.twist.linear.y = m_vel[1] + m_params.odom_noise_vel * m_noise(m_generator);
+	odom->twist.twist.angular.z = m_vel[2] + m_params.odom_noise_vel * m_noise(m_generator);
+	m_planner->odomCallback(odom);
+
+	geometry_msgs::msg::PoseStamped pose;
+	pose.header = odom->header;
+	pose.pose = odom->pose.pose;
+
+	bool is_goal_reached = false;
+	{
+		const auto cycle_begin = std::chrono::steady_clock::now();
+		geometry_msgs::msg::TwistStamped cmd_vel;
+		{
+			// controller server holds the costmap lock as well
+			std::unique_lock<nav2_costmap_2d::Costmap2D::mutex_t> lock(*m_costmap->getMutex());
+			cmd_vel = m_planner->computeVelocityCommands(pose, odom->twist.twist);
+		}
+		is_goal_reached = m_planner->isGoalReached();
+		m_cycle_times.push_back(std::chrono::duration<double>(std::chrono::steady_clock::now() - cycle_begin).count());
+
+		m_cmd[0] = cmd_vel.twist.linear.x;
+		m_cmd[1] = m_params.drive_model == sim_params_t::DRIVE_HOLONOMIC ? cmd_vel.twist.linear.y : 0;
+		m_cmd[2] = cmd_vel.twist.angular.z;
+	}
+
+	// integrate with first order actuator lag (using midpoint method)
+	const double dt = 1 / m_params.control_rate;
+	const int num_substeps = std::max(m_params.num_substeps, 1);
+	const double sub_dt = dt / num_substeps;
+	const double gain = m_params.actuator_lag > 0 ? 1 - exp(-sub_dt / m_params.actuator_lag) : 1;
+	for(int k = 0; k < num_substeps; ++k)
+	{
+		for(int i = 0; i < 3; ++i) {
+			m_vel[i] += (m_cmd[i] - m_vel[i]) * gain;
+		}
+		const double midpoint_yaw = m_pose[2] + m_vel[2] * sub_dt / 2;
+		m_pose[0] += (m_vel[0] * cos(midpoint_yaw) - m_vel[1] * sin(midpoint_yaw)) * sub_dt;
+		m_pose[1] += (m_vel[0] * sin(midpoint_yaw) + m_vel[1] * cos(midpoint_yaw)) * sub_dt;
+		m_pose[2] += m_vel[2] * sub_dt;
+	}
+	m_time += dt;
+	setTime(m_time);
+
+	// metrics
+	m_result.num_cycles++;
+	{
+		double tracking_error = 0;
+		m_plan.findClosest(m_pose[0], m_pose[1], 0, m_plan.size(), &tracking_error);
+		m_sum_tracking_error += tracking_error;
+		m_result.max_tracking_error = fmax(m_result.max_tracking_error, tracking_error);
+	}
+	const double clearance = computeClearance(m_pose[0], m_pose[1]);
+	m_result.min_clearance = fmin(m_result.min_clearance, clearance);
+
+	m_wall_time += std::chrono::duration<double>(std::chrono::steady_clock::now() - step_begin).count();
+
+	if(is_goal_reached) {
+		m_result.is_goal_reached = true;
+		finish();
+	} else if(clearance < m_scenario.robot_radius) {
+		m_result.is_collision = true;
+		finish();
+	} else if(m_time >= m_scenario.timeout) {
+		finish();
+	}
+	return !m_is_done;
+}
+
+const sim_result_t& KinematicSimulator::run()
+{
+	while(step());
+	return m_result;
+}
+
+void KinematicSimulator::updateCostmap()
+{
+	std::unique_lock<nav2_costmap_2d::Costmap2D::mutex_t> lock(*m_costmap->getMutex());
+	unsigned char* costs = m_costmap->getCharMap();
+	std::copy(m_static_costs.begin(), m_static_costs.end(), costs);
+
+	for(const auto& obstacle : m_scenario.obstacles)
+	{
+		const bool is_static = obstacle.vel_x == 0 && obstacle.vel_y == 0 && obstacle.begin_time <= 0 && std::isinf(obstacle.end_time);
+		if(is_static || m_time < obstacle.begin_time || m_time >= obstacle.end_time) {
+			continue;
+		}
+		const double delta_time = m_time - obstacle.begin_time;
+		rasterize(obstacle, obstacle.vel_x * delta_time, obstacle.vel_y * delta_time, costs);
+	}
+}
+
+void KinematicSimulator::rasterize(const sim_obstacle_t& obstacle, double offset_x, double offset_y, unsigned char* costs) const
+{
+	const int size_x = m_costmap->getSizeInCellsX();
+	const int size_y = m_costmap->getSizeInCellsY();
+	const double resolution = m_scenario.resolution;
+	const int x0 = std::max(int(std::floor((obstacle.x0 + offset_x - m_scenario.origin_x) / resolution)), 0);
+	const int y0 = std::max(int(std::floor((obstacle.y0 + offset_y - m_scenario.origin_y) / resolution)), 0);
+	const int x1 = std::min(int(std::floor((obstacle.x1 + offset_x - m_scenario.origin_x) / resolution)), size_x - 1);
+	const int y1 = std::min(int(std::floor((obstacle.y1 + offset_y - m_scenario.origin_y) / resolution)), size_y - 1);
+	const int radius = m_inflation_cells;
+	const int width = 2 * radius + 1;
+
+	for(int y = y0; y <= y1; ++y) {
+		for(int x = x0; x <= x1; ++x)
+		{
+			// inflation of the interior is covered by the border cells
+			if(x > x0 && x < x1 && y > y0 && y < y1) {
+				costs[y * size_x + x] = nav2_costmap_2d::LETHAL_OBSTACLE;
+				continue;
+			}
+			for(int dy = std::max(-radius, -y); dy <= std::min(radius, size_y - 1 - y); ++dy) {
+				for(int dx = std::max(-radius, -x); dx <= std::min(radius, size_x - 1 - x); ++dx)
+				{
+					unsigned char& cost = costs[(y + dy) * size_x + x + dx];
+					cost = std::max(cost, m_inflation_kernel[(dy + radius) * width + dx + radius]);
+				}
+			}
+		}
+	}
+}
+
+double KinematicSimulator::computeClearance(double x, double y) const
+{
+	const int size_x = m_costmap->getSizeInCellsX();
+	const int size_y = m_costmap->getSizeInCellsY();
+	const double resolution = m_scenario.resolution;
+	const unsigned char* costs = m_costmap->getCharMap();
+	const int radius = int(std::ceil(max_clearance / resolution));
+	const int cx = int(std::floor((x - m_scenario.origin_x) / resolution));
+	const int cy = int(std::floor((y - m_scenario.origin_y) / resolution));
+
+	double clearance = max_clearance;
+	for(int my = std::max(cy - radius, 0); my <= std::min(cy + radius, size_y - 1); ++my) {
+		for(int mx = std::max(cx - radius, 0); mx <= std::min(cx + radius, size_x - 1); ++mx)
+		{
+			if(costs[my * size_x + mx] == nav2_costmap_2d::LETHAL_OBSTACLE)
+			{
+				// distance to cell border
+				const double dist = ::hypot(m_scenario.origin_x + (mx + 0.5) * resolution - x,
+											m_scenario.origin_y + (my + 0.5) * resolution - y) - 0.5 * resolution;
+				clearance = fmin(clearance, fmax(dist, 0));
+			}
+		}
+	}
+	return clearance;
+}
+
+void KinematicSimulator::setTime(double time)
+{
+	const rclcpp::Clock::SharedPtr clock = m_node->get_clock();
+	std::lock_guard<std::mutex> lock(clock->get_clock_mutex());
+	rcl_set_ros_time_override(clock->get_clock_handle(), sim_time_offset + int64_t(time * 1e9));
+}
+
+void KinematicSimulator::finish()
+{
+	m_is_done = true;
+	m_result.completion_time = m_time;
+	if(m_result.num_cycles > 0) {
+		m_result.mean_tracking_error = m_sum_tracking_error / m_result.num_cycles;
+	}
+	if(!m_cycle_times.empty())
+	{
+		std::vector<double> sorted = m_cycle_times;
+		std::sort(sorted.begin(), sorted.end());
+		double sum = 0;
+		for(const double value : sorted) {
+			sum += value;
+		}
+		m_result.mean_cycle_time = sum / sorted.size();
+		m_result.p99_cycle_time = sorted[std::min(size_t(std::ceil(0.99 * sorted.size())), sorted.size()) - 1];
+		m_result.max_cycle_time = sorted.back();
+	}
+	m_result.real_time_factor = m_wall_time > 0 ? m_time / m_wall_time : 0;
+}
+
+
+} // neo_local_planner
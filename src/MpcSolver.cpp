@@ -0,0 +1,258 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2016, Neobotix GmbH
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Neobotix nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+#include "../include/MpcSolver.h"
+
+#include <algorithm>
+#include <cmath>
+
+
+namespace neo_local_planner {
+
+static double wrap_angle(double angle)
+{
+	return ::atan2(::sin(angle), ::cos(angle));
+}
+
+static double clamp(double value, double min, double max)
+{
+	return std::min(std::max(value, min), max);
+}
+
+void MpcSolver::setParams(const params_t& params)
+{
+	m_params = params;
+	m_params.horizon = std::max(m_params.horizon, 1);
+
+	const size_t N = m_params.horizon;
+	m_controls.assign(N, control_t());
+	m_candidate.assign(N, control_t());
+	m_gradient.assign(N, control_t());
+	m_states.assign(N + 1, pose_t());
+	m_candidate_states.assign(N + 1, pose_t());
+	m_adjoint.assign(N + 1, pose_t());
+	reset();
+}
+
+void MpcSolver::setVelocityLimits(const control_t& min_vel, const control_t& max_vel)
+{
+	m_params.min_vel = min_vel;
+	m_params.max_vel = max_vel;
+}
+
+void MpcSolver::reset()
+{
+	m_have_solution = false;
+	m_step_size = 0.1;
+}
+
+double MpcSolver::evaluate(	const std::vector<control_t>& controls, std::vector<pose_t>& states,
+							const std::vector<pose_t>& reference, const cost_func_t& cost_func) const
+{
+	const double dt = m_params.dt;
+	double cost = 0;
+	control_t last = m_start_vel;
+
+	for(size_t k = 0; k < controls.size(); ++k)
+	{
+		// midpoint method, same as SE2::predict()
+		const pose_t& x = states[k];
+		const control_t& u = controls[k];
+		const double c = ::cos(x.yaw + 0.5 * u.yawrate * dt);
+		const double s = ::sin(x.yaw + 0.5 * u.yawrate * dt);
+
+		pose_t& next = states[k + 1];
+		next.x = x.x + (u.vx * c - u.vy * s) * dt;
+		next.y = x.y + (u.vx * s + u.vy * c) * dt;
+		next.yaw = x.yaw + u.yawrate * dt;
+
+		const pose_t& ref = reference[k + 1];
+		const double yaw_error = wrap_angle(next.yaw - ref.yaw);
+		double grad[2] = {};
+		cost += m_params.weight_pos * (pow(next.x - ref.x, 2) + pow(next.y - ref.y, 2))
+				+ m_params.weight_yaw * yaw_error * yaw_error
+				+ m_params.weight_cost * cost_func(next.x, next.y, grad)
+				+ m_params.weight_smooth * (pow(u.vx - last.vx, 2) + pow(u.vy - last.vy, 2) + pow(u.yawrate - last.yawrate, 2));
+		last = u;
+	}
+	return cost;
+}
+
+void MpcSolver::computeGradient(const std::vector<pose_t>& reference, const cost_func_t& cost_func)
+{
+	// backwards pass: adjoint[k] = dJ/dstate[k]
+	const double dt = m_params.dt;
+	const size_t N = m_controls.size();
+	m_adjoint[N] = pose_t();
+
+	for(size_t k = N; k > 0; --k)
+	{
+		// state cost at step k
+		const pose_t& x = m_states[k];
+		const pose_t& ref = reference[k];
+		double grad[2] = {};
+		cost_func(x.x, x.y, grad);
+
+		pose_t& lambda = m_adjoint[k];
+		lambda.x += 2 * m_params.weight_pos * (x.x - ref.x) + m_params.weight_cost * grad[0];
+		lambda.y += 2 * m_params.weight_pos * (x.y - ref.y) + m_params.weight_cost * grad[1];
+		lambda.yaw += 2 * m_params.weight_yaw * wrap_angle(x.yaw - ref.yaw);
+
+		// propagate through model x[k] = f(x[k-1], u[k-1])
+		const pose_t& prev = m_states[k - 1];
+		const control_t& u = m_controls[k - 1];
+		const double c = ::cos(prev.yaw + 0.5 * u.yawrate * dt);
+		const double s = ::sin(prev.yaw + 0.5 * u.yawrate * dt);
+
+		// derivative of x[k] by the midpoint yaw
+		const double d_yaw = lambda.x * (-u.vx * s - u.vy * c) * dt + lambda.y * (u.vx * c - u.vy * s) * dt;
+
+		control_t& g = m_gradient[k - 1];
+		g.vx = (lambda.x * c + lambda.y * s) * dt;
+		g.vy = (-lambda.x * s + lambda.y * c) * dt;
+		g.yawrate = lambda.yaw * dt + 0.5 * dt * d_yaw;
+
+		pose_t& prev_lambda = m_adjoint[k - 1];
+		prev_lambda.x = lambda.x;
+		prev_lambda.y = lambda.y;
+		prev_lambda.yaw = lambda.yaw + d_yaw;
+	}
+
+	// smoothness terms
+	for(size_t k = 0; k < N; ++k)
+	{
+		const control_t& u = m_controls[k];
+		const control_t& last = k > 0 ? m_controls[k - 1] : m_start_vel;
+		control_t& g = m_gradient[k];
+		g.vx += 2 * m_params.weight_smooth * (u.vx - last.vx);
+		g.vy += 2 * m_params.weight_smooth * (u.vy - last.vy);
+		g.yawrate += 2 * m_params.weight_smooth * (u.yawrate - last.yawrate);
+
+		if(k + 1 < N) {
+			const control_t& next = m_controls[k + 1];
+			g.vx -= 2 * m_params.weight_smooth * (next.vx - u.vx);
+			g.vy -= 2 * m_params.weight_smooth * (next.vy - u.vy);
+			g.yawrate -= 2 * m_params.weight_smooth * (next.yawrate - u.yawrate);
+		}
+	}
+}
+
+void MpcSolver::project(std::vector<control_t>& controls) const
+{
+	// forward pass keeps every step within velocity and acceleration limits
+	const double dt = m_params.dt;
+	control_t last = m_start_vel;
+
+	for(auto& u : controls)
+	{
+		u.vx = clamp(u.vx, last.vx - m_params.acc_lim.vx * dt, last.vx + m_params.acc_lim.vx * dt);
+		u.vy = clamp(u.vy, last.vy - m_params.acc_lim.vy * dt, last.vy + m_params.acc_lim.vy * dt);
+		u.yawrate = clamp(u.yawrate, last.yawrate - m_params.acc_lim.yawrate * dt, last.yawrate + m_params.acc_lim.yawrate * dt);
+
+		u.vx = clamp(u.vx, m_params.min_vel.vx, m_params.max_vel.vx);
+		u.vy = clamp(u.vy, m_params.min_vel.vy, m_params.max_vel.vy);
+		u.yawrate = clamp(u.yawrate, m_params.min_vel.yawrate, m_params.max_vel.yawrate);
+		last = u;
+	}
+}
+
+MpcSolver::control_t MpcSolver::solve(	const pose_t& start, const control_t& start_vel,
+										const std::vector<pose_t>& reference, const cost_func_t& cost_func, stats_t* stats)
+{
+	const size_t N = m_controls.size();
+	m_start_vel = start_vel;
+
+	if(reference.size() < N + 1) {
+		return start_vel;
+	}
+
+	// warm start: shift previous solution by one step
+	if(m_have_solution) {
+		std::rotate(m_controls.begin(), m_controls.begin() + 1, m_controls.end());
+		m_controls[N - 1] = m_controls[N > 1 ? N - 2 : 0];
+	} else {
+		std::fill(m_controls.begin(), m_controls.end(), start_vel);
+	}
+	project(m_controls);
+
+	m_states[0] = start;
+	m_candidate_states[0] = start;
+	double cost = evaluate(m_controls, m_states, reference, cost_func);
+
+	stats_t tmp;
+	tmp.initial_cost = cost;
+
+	for(int iter = 0; iter < m_params.max_iterations; ++iter)
+	{
+		computeGradient(reference, cost_func);
+		tmp.num_iterations++;
+
+		// backtracking line search on the projected step
+		bool is_improved = false;
+		for(int i = 0; i < 4; ++i)
+		{
+			for(size_t k = 0; k < N; ++k) {
+				m_candidate[k].vx = m_controls[k].vx - m_step_size * m_gradient[k].vx;
+				m_candidate[k].vy = m_controls[k].vy - m_step_size * m_gradient[k].vy;
+				m_candidate[k].yawrate = m_controls[k].yawrate - m_step_size * m_gradient[k].yawrate;
+			}
+			project(m_candidate);
+
+			const double new_cost = evaluate(m_candidate, m_candidate_states, reference, cost_func);
+			if(new_cost < cost) {
+				cost = new_cost;
+				m_controls.swap(m_candidate);
+				m_states.swap(m_candidate_states);
+				m_step_size *= 1.5;
+				is_improved = true;
+				break;
+			}
+			m_step_size *= 0.5;
+		}
+		if(!is_improved) {
+			break;
+		}
+	}
+	m_step_size = clamp(m_step_size, 1e-4, 10);
+	m_have_solution = true;
+
+	tmp.final_cost = cost;
+	if(stats) {
+		*stats = tmp;
+	}
+	return m_controls[0];
+}
+
+
+} // neo_local_planner
@@ -40,15 +40,30 @@
 #include <tf2_geometry_msgs/tf2_geometry_msgs.h>
 #include <vector>
 #include "nav2_util/line_iterator.hpp"
-#include "nav2_core/goal_checker.hpp"
 #include "pluginlib/class_list_macros.hpp"
 #include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <limits>
 #include <nav_2d_utils/tf_help.hpp>
 #include <tf2_eigen/tf2_eigen.h>
 
+#include <sys/mman.h>
+#include <unistd.h>
+
 
 namespace neo_local_planner {
 
+// finest step and longest horizon of the obstacle scan
+static const double max_scan_step = 0.05;
+static const double max_scan_dist = 10;
+
+// speed step of one byte in the published speed limit map [m/s]
+static const double speed_map_resolution = 0.02;
+
+// > 0 while the thread runs computeVelocityCommandsBatch()
+static thread_local int g_batch_depth = 0;
+
 tf2::Quaternion createQuaternionFromYaw(double yaw)
 {
 	tf2::Quaternion q;
@@ -56,117 +71,570 @@ tf2::Quaternion createQuaternionFromYaw(double yaw)
 	return q;
 }
 
-std::vector<tf2::Transform>::const_iterator find_closest_point(	std::vector<tf2::Transform>::const_iterator begin,
-															std::vector<tf2::Transform>::const_iterator end,
-															const tf2::Vector3& pos,
-															double* actual_dist = 0)
+SE2 to_se2(const tf2::Transform& transform)
+{
+	return SE2(transform.getOrigin().x(), transform.getOrigin().y(), tf2::getYaw(transform.getRotation()));
+}
+
+SE2 to_se2(const geometry_msgs::msg::Pose& pose)
+{
+	return SE2(pose.position.x, pose.position.y, tf2::getYaw(pose.orientation));
+}
+
+std_msgs::msg::UInt8MultiArray to_speed_map_msg(const std::vector<uint8_t>& data)
+{
+	std_msgs::msg::UInt8MultiArray msg;
+	msg.layout.dim.resize(1);
+	msg.layout.dim[0].label = "station";
+	msg.layout.dim[0].size = data.size();
+	msg.layout.dim[0].stride = data.size();
+	msg.data = data;
+	return msg;
+}
+
+nav2_util::LineIterator get_line_iterator(
+								nav2_costmap_2d::Costmap2D* cost_map,
+								const point2_t& world_pos_0,
+								const point2_t& world_pos_1)
+{
+	int coords[2][2] = {};
+	cost_map->worldToMapEnforceBounds(world_pos_0.x, world_pos_0.y, coords[0][0], coords[0][1]);
+	cost_map->worldToMapEnforceBounds(world_pos_1.x, world_pos_1.y, coords[1][0], coords[1][1]);
+
+	// Line iterator for determining the cells between two points
+	return nav2_util::LineIterator(coords[0][0], coords[0][1], coords[1][0], coords[1][1]);
+}
+
+double get_cost(nav2_costmap_2d::Costmap2D* cost_map_, const EgoCostGrid* ego_grid, const point2_t& world_pos)
 {
-	auto iter_short = begin;
-	double dist_short = std::numeric_limits<double>::infinity();
+	unsigned char cost = 0;
+	if(ego_grid && ego_grid->getCost(world_pos.x, world_pos.y, cost)) {
+		return cost / 255.;
+	}
 
-	for(auto iter = iter_short; iter != end; ++iter)
+	int coords[2] = {};
+	cost_map_->worldToMapEnforceBounds(world_pos.x, world_pos.y, coords[0], coords[1]);
+
+	return cost_map_->getCost(coords[0], coords[1]) / 255.;
+
+}
+
+double compute_avg_line_cost(	nav2_costmap_2d::Costmap2D* cost_map_,
+								const EgoCostGrid* ego_grid,
+								const point2_t& world_pos_0,
+								const point2_t& world_pos_1)
+{
+	double avg_cost = 0;
+	if(ego_grid && ego_grid->getAvgLineCost(world_pos_0.x, world_pos_0.y, world_pos_1.x, world_pos_1.y, avg_cost)) {
+		return avg_cost;
+	}
+	size_t num_cells = 0;
+	for(auto line = get_line_iterator(cost_map_, world_pos_0, world_pos_1); line.isValid(); line.advance())
 	{
-		const double dist = (iter->getOrigin() - pos).length();
-		if(dist < dist_short)
-		{
-			dist_short = dist;
-			iter_short = iter;
-		}
+		avg_cost += (double)cost_map_->getCost(line.getX(), line.getY()) / 255.;
+		num_cells++;
 	}
-	if(actual_dist) {
-		*actual_dist = dist_short;
+
+	return avg_cost / num_cells;
+}
+
+double compute_max_line_cost(	nav2_costmap_2d::Costmap2D* cost_map_,
+								const EgoCostGrid* ego_grid,
+								const point2_t& world_pos_0,
+								const point2_t& world_pos_1)
+{
+	double grid_cost = 0;
+	if(ego_grid && ego_grid->getMaxLineCost(world_pos_0.x, world_pos_0.y, world_pos_1.x, world_pos_1.y, grid_cost)) {
+		return grid_cost;
 	}
-	return iter_short;
+
+	int max_cost = 0;
+	for(auto line = get_line_iterator(cost_map_, world_pos_0, world_pos_1); line.isValid(); line.advance()) {
+		max_cost = std::max(max_cost, int(cost_map_->getCost(line.getX(), line.getY())));
+	}
+	return max_cost / 255.;
 }
 
-std::vector<tf2::Transform>::const_iterator move_along_path(	std::vector<tf2::Transform>::const_iterator begin,
-														std::vector<tf2::Transform>::const_iterator end,
-														const double dist, double* actual_dist = 0)
+bool NeoLocalPlanner::isSegmentDirty(const scan_sample_t& a, const scan_sample_t& b) const
 {
-	auto iter = begin;
-	auto iter_prev = iter;
-	double dist_left = dist;
+	const double margin = costmap_->getResolution();
+	return fmax(a.x, b.x) + margin >= m_dirty_bounds[0] && fmin(a.x, b.x) - margin <= m_dirty_bounds[2]
+		&& fmax(a.y, b.y) + margin >= m_dirty_bounds[1] && fmin(a.y, b.y) - margin <= m_dirty_bounds[3];
+}
 
-	while(iter != end)
+void NeoLocalPlanner::getDirtyBounds(double bounds[4]) const
+{
+	if(!costmap_ros_)
+	{
+		// plain costmap, could have changed anywhere
+		bounds[0] = -std::numeric_limits<double>::infinity();
+		bounds[1] = -std::numeric_limits<double>::infinity();
+		bounds[2] = std::numeric_limits<double>::infinity();
+		bounds[3] = std::numeric_limits<double>::infinity();
+	}
+	else
 	{
-		const double dist = (iter->getOrigin() - iter_prev->getOrigin()).length();
-		dist_left -= dist;
-		if(dist_left <= 0) {
+		unsigned int cells[4] = {};		// x0, xn, y0, yn
+		costmap_ros_->getLayeredCostmap()->getBounds(&cells[0], &cells[1], &cells[2], &cells[3]);
+
+		if(cells[0] < cells[1] && cells[2] < cells[3]) {
+			costmap_->mapToWorld(cells[0], cells[2], bounds[0], bounds[1]);
+			costmap_->mapToWorld(cells[1], cells[3], bounds[2], bounds[3]);
+		} else {
+			bounds[0] = std::numeric_limits<double>::infinity();
+			bounds[1] = std::numeric_limits<double>::infinity();
+			bounds[2] = -std::numeric_limits<double>::infinity();
+			bounds[3] = -std::numeric_limits<double>::infinity();
+		}
+	}
+}
+
+NeoLocalPlanner::obstacle_scan_t NeoLocalPlanner::scanObstacles(	const SE2& start_pose, double curvature,
+																	double delta_move, double max_dist, const EgoCostGrid* ego_grid)
+{
+	// get area of last costmap update
+	getDirtyBounds(m_dirty_bounds);
+
+	scan_sample_t start;
+	start.x = start_pose.x();
+	start.y = start_pose.y();
+	start.yaw = start_pose.yaw();
+	start.cost = compute_max_line_cost(costmap_, ego_grid, start_pose.position(), start_pose.position());
+
+	// check how much of the previous scan is still valid
+	size_t reuse_begin = 0;
+	size_t reuse_end = 0;
+	findScanReuse(start_pose, curvature, reuse_begin, reuse_end);
+
+	const double reuse_offset = reuse_end > reuse_begin ? m_scan_samples[reuse_begin - 1].dist : 0;
+	m_scan_age = reuse_end > reuse_begin ? m_scan_age + 1 : 0;
+
+	obstacle_scan_t result;
+	std::vector<scan_sample_t>& samples = m_scan_buffer;
+	samples.clear();
+	samples.reserve(size_t(max_dist / delta_move) + 2);
+
+	scan_sample_t sample = start;
+	size_t index = reuse_begin;
+	while(true)
+	{
+		bool is_contained = false;
+		{
+			unsigned int dummy[2] = {};
+			is_contained = costmap_->worldToMap(sample.x, sample.y, dummy[0], dummy[1]);
+		}
+		result.have_obstacle = sample.cost >= max_cost;
+		result.obstacle_cost = fmax(result.obstacle_cost, sample.cost);
+		result.obstacle_dist = sample.dist;
+		samples.push_back(sample);
+
+		if(!is_contained || result.have_obstacle) {
 			break;
 		}
-		iter_prev = iter;
-		iter++;
+
+		const scan_sample_t last = sample;
+		if(index < reuse_end && m_scan_samples[index].dist - reuse_offset < max_dist)
+		{
+			// take sample from previous scan, re-evaluate only if needed
+			sample = m_scan_samples[index];
+			sample.dist -= reuse_offset;
+			if(index == reuse_begin || isSegmentDirty(last, sample)) {
+				sample.cost = compute_max_line_cost(costmap_, ego_grid, point2_t(last.x, last.y), point2_t(sample.x, sample.y));
+			}
+			index++;
+		}
+		else
+		{
+			if(last.dist + delta_move >= max_dist) {
+				result.obstacle_dist += delta_move;
+				break;
+			}
+			double sin_yaw = 0;
+			double cos_yaw = 1;
+			sin_cos(last.yaw, sin_yaw, cos_yaw);
+			sample.x = last.x + delta_move * cos_yaw;
+			sample.y = last.y + delta_move * sin_yaw;
+			sample.yaw = last.yaw + curvature * delta_move;
+			sample.dist = last.dist + delta_move;
+			sample.cost = compute_max_line_cost(costmap_, ego_grid, point2_t(last.x, last.y), point2_t(sample.x, sample.y));
+		}
+	}
+
+	m_scan_samples.swap(samples);
+	m_scan_curvature = curvature;
+	return result;
+}
+
+bool NeoLocalPlanner::findScanReuse(const SE2& start_pose, double curvature, size_t& reuse_begin, size_t& reuse_end) const
+{
+	reuse_begin = 0;
+	reuse_end = 0;
+	if(scan_reuse_tolerance <= 0 || m_scan_age >= scan_refresh_cycles || m_scan_samples.empty()) {
+		return false;
+	}
+	size_t closest = 0;
+	double closest_dist = std::numeric_limits<double>::infinity();
+	for(size_t i = 0; i < m_scan_samples.size(); ++i)
+	{
+		const double dist = ::hypot(m_scan_samples[i].x - start_pose.x(), m_scan_samples[i].y - start_pose.y());
+		if(dist < closest_dist) {
+			closest_dist = dist;
+			closest = i;
+		}
 	}
-	if(iter == end) {
-		iter = iter_prev;		// targeting final pose
+	const double yaw_error = fabs(angles::shortest_angular_distance(m_scan_samples[closest].yaw, start_pose.yaw()));
+	const double delta_curvature = fabs(curvature - m_scan_curvature);
+	const double margin = scan_reuse_tolerance - closest_dist;
+
+	if(margin <= 0) {
+		return false;
 	}
-	if(actual_dist) {
-		*actual_dist = dist - dist_left;
+	// arc length until lateral divergence (yaw_error * s + delta_curvature * s^2 / 2) exceeds margin
+	double max_length = std::numeric_limits<double>::infinity();
+	if(delta_curvature > 1e-9) {
+		max_length = (sqrt(yaw_error * yaw_error + 2 * delta_curvature * margin) - yaw_error) / delta_curvature;
+	} else if(yaw_error > 1e-9) {
+		max_length = margin / yaw_error;
 	}
-	return iter;
+
+	reuse_begin = closest + 1;
+	reuse_end = reuse_begin;
+	while(reuse_end < m_scan_samples.size()
+		&& m_scan_samples[reuse_end].dist - m_scan_samples[closest].dist <= max_length)
+	{
+		reuse_end++;
+	}
+	return reuse_end > reuse_begin;
 }
 
-std::vector<std::pair <int,int> > get_line_cells(
-								nav2_costmap_2d::Costmap2D* cost_map,
-								const tf2::Vector3& world_pos_0,
-								const tf2::Vector3& world_pos_1)
+NeoLocalPlanner::obstacle_scan_t NeoLocalPlanner::runObstacleScan(	const SE2& start_pose,
+																	double start_vel_x, double start_yawrate, int degrade_level,
+																	const EgoCostGrid* ego_grid)
 {
-	int coords[2][2] = {};
-	cost_map->worldToMapEnforceBounds(world_pos_0.x(), world_pos_0.y(), coords[0][0], coords[0][1]);
-	cost_map->worldToMapEnforceBounds(world_pos_1.x(), world_pos_1.y(), coords[1][0], coords[1][1]);
+	const double curvature = start_vel_x > trans_stopped_vel ? start_yawrate / start_vel_x : 0;
+	double scan_step = max_scan_step;
+	double scan_dist = max_scan_dist;
+	if(degrade_level >= DEGRADE_COARSE_SCAN) {
+		scan_step = 0.1;
+	}
+	if(degrade_level >= DEGRADE_SHORT_SCAN) {
+		// never shorter than what we need to stop
+		const double stop_dist = start_vel_x * start_vel_x / (2 * 0.9 * fmax(acc_lim_x, 1e-3)) + min_stop_dist;
+		scan_dist = fmin(fmax(0.5 * scan_dist, 2 * stop_dist), scan_dist);
+	}
+	// templates only replace full scans, a warm start from the last scan (of either kind) comes first
+	size_t reuse_begin = 0;
+	size_t reuse_end = 0;
+	obstacle_scan_t result;
+	if(!findScanReuse(start_pose, curvature, reuse_begin, reuse_end)
+		&& scanObstaclesTemplated(start_pose, curvature, scan_dist, result, ego_grid))
+	{
+		return result;
+	}
+	return scanObstacles(start_pose, curvature, scan_step, scan_dist, ego_grid);
+}
 
-	// Creating a vector for storing the value of the cells
-	
-	std::vector< std::pair <int,int> > cells;
+bool NeoLocalPlanner::scanObstaclesTemplated(	const SE2& start_pose, double curvature,
+												double max_dist, obstacle_scan_t& result, const EgoCostGrid* ego_grid)
+{
+	if(!m_scan_templates || m_scan_templates->empty()) {
+		return false;
+	}
+	const ScanTemplates::params_t& params = m_scan_templates->getParams();
+	if(fabs(costmap_->getResolution() - params.resolution) > 1e-6) {
+		return false;
+	}
+	unsigned int start_cell[2] = {};
+	if(!costmap_->worldToMap(start_pose.x(), start_pose.y(), start_cell[0], start_cell[1])) {
+		return false;
+	}
 
-	// Line iterator for determining the cells between two points
- 	for (nav2_util::LineIterator line(coords[0][0], coords[0][1], coords[1][0], coords[1][1]); line.isValid(); line.advance())
- 	{
-        cells.push_back( std::make_pair(line.getX(),line.getY()) );
-    }
-    // Mandatory reversal
-    // std::reverse( cells.begin(), cells.end() );
+	// smallest cost which counts as obstacle
+	int stop_cost = 0;
+	while(stop_cost < 256 && stop_cost / 255. < max_cost) {
+		stop_cost++;
+	}
+
+	const double start_yaw = start_pose.yaw();
+	ScanTemplates::scan_result_t scan;
+	if(!m_scan_templates->scan(	costmap_->getCharMap(), costmap_->getSizeInCellsX(), costmap_->getSizeInCellsY(),
+								start_cell[0], start_cell[1], start_yaw, curvature,
+								int(max_dist / params.step) + 1, stop_cost, m_scan_step_costs.data(), scan))
+	{
+		return false;
+	}
+
+	// costs come from the template, beyond it we continue the exact scan
+	std::vector<scan_sample_t>& samples = m_scan_buffer;
+	samples.clear();
+	samples.reserve(size_t(max_dist / params.step) + 2);
+
+	scan_sample_t sample;
+	sample.x = start_pose.x();
+	sample.y = start_pose.y();
+	sample.yaw = start_yaw;
+	scan_sample_t last = sample;
 
-	return cells;
+	result = obstacle_scan_t();
+	for(int i = 0; true; ++i)
+	{
+		bool is_contained = true;
+		if(i < scan.num_steps)
+		{
+			sample.cost = m_scan_step_costs[i] / 255.;
+			is_contained = !(scan.left_map && i + 1 == scan.num_steps);
+		}
+		else
+		{
+			unsigned int dummy[2] = {};
+			is_contained = costmap_->worldToMap(sample.x, sample.y, dummy[0], dummy[1]);
+			sample.cost = compute_max_line_cost(costmap_, ego_grid, point2_t(last.x, last.y), point2_t(sample.x, sample.y));
+		}
+		result.have_obstacle = sample.cost >= max_cost;
+		result.obstacle_cost = fmax(result.obstacle_cost, sample.cost);
+		result.obstacle_dist = sample.dist;
+		samples.push_back(sample);
+
+		if(!is_contained || result.have_obstacle) {
+			break;
+		}
+		if(sample.dist + params.step >= max_dist) {
+			result.obstacle_dist += params.step;
+			break;
+		}
+		last = sample;
+		double sin_yaw = 0;
+		double cos_yaw = 1;
+		sin_cos(last.yaw, sin_yaw, cos_yaw);
+		sample.x = last.x + params.step * cos_yaw;
+		sample.y = last.y + params.step * sin_yaw;
+		sample.yaw = last.yaw + curvature * params.step;
+		sample.dist = last.dist + params.step;
+	}
+
+	m_scan_samples.swap(samples);
+	m_scan_curvature = curvature;
+	m_scan_age = 0;
+	return true;
 }
 
-double get_cost(nav2_costmap_2d::Costmap2D* cost_map_, const tf2::Vector3& world_pos)
+void NeoLocalPlanner::computeGradients(	const SE2& pose, double cost_y_lookahead_dist,
+										bool skip_xy, bool skip_yaw, double* delta_cost,
+										const EgoCostGrid* ego_grid) const
 {
+	const double delta_x = 0.3;
+	const double delta_y = 0.2;
+	const double delta_yaw = 0.1;
+	const point2_t pos = pose.position();
 
+	if(!skip_xy)
+	{
+		delta_cost[0] = (
+			compute_avg_line_cost(costmap_, ego_grid, pos, pose * point2_t(delta_x, 0)) -
+			compute_avg_line_cost(costmap_, ego_grid, pos, pose * point2_t(-delta_x, 0)))
+			/ delta_x;
+
+		delta_cost[1] = (
+			compute_avg_line_cost(costmap_, ego_grid, pos, pose * point2_t(cost_y_lookahead_dist, delta_y)) -
+			compute_avg_line_cost(costmap_, ego_grid, pos, pose * point2_t(cost_y_lookahead_dist, -delta_y)))
+			/ delta_y;
+	}
+	if(!skip_yaw)
+	{
+		const SE2 pose_left = pose * SE2(0, 0, delta_yaw);
+		const SE2 pose_right = pose * SE2(0, 0, -delta_yaw);
+		delta_cost[2] = (
+			(
+				compute_avg_line_cost(costmap_, ego_grid,	pose_left * point2_t(delta_x, 0),
+												pose_left * point2_t(-delta_x, 0))
+			) - (
+				compute_avg_line_cost(costmap_, ego_grid,	pose_right * point2_t(delta_x, 0),
+												pose_right * point2_t(-delta_x, 0))
+			)) / (2 * delta_yaw);
+	}
+}
 
-	int coords[2] = {};
-	cost_map_->worldToMapEnforceBounds(world_pos.x(), world_pos.y(), coords[0], coords[1]);
-
-	return cost_map_->getCost(coords[0], coords[1]) / 255.;
+void NeoLocalPlanner::perceptionUpdate()
+{
+	// re-run even without new input since the costmap may have changed
+	perception_input_t& input = m_perception_work_input;
+	perception_result_t& result = m_perception_work_result;
 
+	m_perception_input_version = m_perception_input.read(input, m_perception_input_version);
+	if(m_perception_input_version == 0) {
+		return;
+	}
+	{
+		std::unique_lock<nav2_costmap_2d::Costmap2D::mutex_t> costmap_lock(*costmap_->getMutex());
+		result.stamp = clock_->now();
+		computeGradients(input.pose, input.cost_y_lookahead_dist, false, false, result.delta_cost, nullptr);
+		result.obstacle_scan = runObstacleScan(input.pose, input.start_vel_x, input.start_yawrate, input.degrade_level, nullptr);
+	}
+	result.samples = m_scan_samples;
+	m_perception_output.write(result);
 }
 
-double compute_avg_line_cost(	nav2_costmap_2d::Costmap2D* cost_map_,
-								const tf2::Vector3& world_pos_0,
-								const tf2::Vector3& world_pos_1)
+void NeoLocalPlanner::supportUpdate()
 {
-	const std::vector< std::pair<int, int> > cells = get_line_cells(cost_map_, world_pos_0, world_pos_1);
+	// tf2 lookups allocate, keep them out of the control loop
+	try {
+		tf2::Stamped<tf2::Transform> global_to_local;
+		tf2::fromMsg(tf_->lookupTransform(m_local_frame, m_global_frame, tf2::TimePointZero), global_to_local);
+		m_global_to_local.write(to_se2(global_to_local));
+	} catch(...) {
+		m_log->logThrottled(log_throttle_period, AsyncLogger::LEVEL_WARN, "lookupTransform(%s, %s) failed",
+							m_local_frame.c_str(), m_global_frame.c_str());
+	}
 
-	double avg_cost = 0;
-	for(auto cell : cells) {
+	const uint64_t local_plan_version = m_local_plan_output.read(m_support_local_plan, m_support_local_plan_version);
+	if(local_plan_version > m_support_local_plan_version && m_local_plan_pub->is_activated())
+	{
+		nav_msgs::msg::Path local_path;
+		local_path.header.frame_id = m_local_frame;
+		local_path.header.stamp = m_support_local_plan.stamp;
 
-		avg_cost += (double)cost_map_->getCost(cell.first, cell.second) / 255.;
+		for(const auto& sample : m_support_local_plan.samples)
+		{
+			geometry_msgs::msg::PoseStamped tmp;
+			tmp.header = local_path.header;
+			tmp.pose.position.x = sample.x;
+			tmp.pose.position.y = sample.y;
+			tmp.pose.orientation = tf2::toMsg(createQuaternionFromYaw(sample.yaw));
+			local_path.poses.push_back(tmp);
+		}
+		m_local_plan_pub->publish(local_path);
 	}
+	m_support_local_plan_version = local_plan_version;
 
-	return avg_cost / cells.size();
+	std::array<uint64_t, NUM_DEGRADE_LEVELS> counts;
+	const uint64_t counts_version = m_degrade_counts_output.read(counts, m_support_degrade_counts_version);
+	if(counts_version > m_support_degrade_counts_version && m_degrade_pub->is_activated())
+	{
+		std_msgs::msg::UInt64MultiArray msg;
+		msg.data.assign(counts.begin(), counts.end());
+		m_degrade_pub->publish(msg);
+	}
+	m_support_degrade_counts_version = counts_version;
+
+	const uint64_t speed_map_version = m_speed_map_output.read(m_support_speed_map, m_support_speed_map_version);
+	if(speed_map_version > m_support_speed_map_version && m_speed_map_pub && m_speed_map_pub->is_activated()) {
+		m_speed_map_pub->publish(to_speed_map_msg(m_support_speed_map));
+	}
+	m_support_speed_map_version = speed_map_version;
 }
 
-double compute_max_line_cost(	nav2_costmap_2d::Costmap2D* cost_map_,
-								const tf2::Vector3& world_pos_0,
-								const tf2::Vector3& world_pos_1)
+/*
+ * Turns towards the path to correct lateral error, rotates on the spot when stopped.
+ */
+struct NeoLocalPlanner::differential_drive_t : NeoLocalPlanner::drive_policy_base_t
 {
-	const std::vector< std::pair<int, int> > cells = get_line_cells(cost_map_, world_pos_0, world_pos_1);
+	static const bool has_lateral_vel = false;
 
-	int max_cost = 0;
-	for(auto cell : cells) {
-		max_cost = std::max(max_cost, int(cost_map_->getCost(cell.first, cell.second)));
+	static void apply(	NeoLocalPlanner& planner, const control_input_t& in,
+						double& control_vel_x, double& control_vel_y, double& control_yawrate)
+	{
+		state_t& state = planner.m_state;
+
+		if(fabs(in.start_vel_x) > (state == state_t::STATE_TRANSLATING ?
+								planner.trans_stopped_vel : 2 * planner.trans_stopped_vel))
+		{
+			// we are translating, use term for lane keeping
+			control_yawrate = in.pos_error_y / in.start_vel_x * planner.pos_y_yaw_gain;
+
+			if(!in.is_goal_target)
+			{
+				// additional term for lane keeping
+				control_yawrate += in.yaw_error * planner.yaw_gain;
+
+				// add cost terms
+				control_yawrate -= in.delta_cost_y / in.start_vel_x * planner.cost_y_yaw_gain;
+				control_yawrate -= in.delta_cost_yaw * planner.cost_yaw_gain;
+			}
+
+			state = state_t::STATE_TRANSLATING;
+		}
+		else if(state == state_t::STATE_TURNING)
+		{
+			// continue on current yawrate
+			control_yawrate = (in.start_yawrate > 0 ? 1 : -1) * in.max_rot_vel;
+		}
+		else if(in.is_goal_target
+				&& (state == state_t::STATE_ADJUSTING || fabs(in.yaw_error) < M_PI / 6)
+				&& fabs(in.pos_error_y) > (state == state_t::STATE_ADJUSTING ?
+					0.25 * planner.xy_goal_tolerance : 0.5 * planner.xy_goal_tolerance))
+		{
+			// we are not translating, but we have too large y error
+			control_yawrate = (in.pos_error_y > 0 ? 1 : -1) * in.max_rot_vel;
+
+			state = state_t::STATE_ADJUSTING;
+		}
+		else
+		{
+			// use term for static target orientation
+			control_yawrate = in.yaw_error * planner.static_yaw_gain;
+
+			state = state_t::STATE_ROTATING;
+		}
 	}
-	return max_cost / 255.;
+};
+
+/*
+ * Corrects lateral error and cost gradients directly with y velocity.
+ */
+struct NeoLocalPlanner::holonomic_drive_t : NeoLocalPlanner::drive_policy_base_t
+{
+	static const bool has_lateral_vel = true;
+
+	static void apply(	NeoLocalPlanner& planner, const control_input_t& in,
+						double& control_vel_x, double& control_vel_y, double& control_yawrate)
+	{
+		state_t& state = planner.m_state;
+
+		// simply correct y with holonomic drive
+		control_vel_y = in.pos_error_y * planner.pos_y_gain;
+
+		if(state == state_t::STATE_TURNING)
+		{
+			// continue on current yawrate
+			control_yawrate = (in.start_yawrate > 0 ? 1 : -1) * in.max_rot_vel;
+		}
+		else
+		{
+			// use term for static target orientation
+			control_yawrate = in.yaw_error * planner.static_yaw_gain;
+
+			if(fabs(in.start_vel_x) > planner.trans_stopped_vel) {
+				state = state_t::STATE_TRANSLATING;
+			} else {
+				state = state_t::STATE_ROTATING;
+			}
+		}
+
+		// apply x cost term only when rotating
+		if(state == state_t::STATE_ROTATING && fabs(in.yaw_error) > M_PI / 6)
+		{
+			control_vel_x -= in.delta_cost_x * planner.cost_x_gain;
+		}
+
+		// apply y cost term when not approaching goal or if we are rotating
+		if(!in.is_goal_target || (state == state_t::STATE_ROTATING && fabs(in.yaw_error) > M_PI / 6))
+		{
+			control_vel_y -= in.delta_cost_y * planner.cost_y_gain;
+		}
+
+		// apply yaw cost term when not approaching goal
+		if(!in.is_goal_target)
+		{
+			control_yawrate -= in.delta_cost_yaw * planner.cost_yaw_gain;
+		}
+	}
+};
+
+bool NeoLocalPlanner::drive_policy_base_t::isStuck(const NeoLocalPlanner& planner, const control_input_t& in)
+{
+	// blocked ahead, cost rising ahead and done rotating towards the path
+	return in.have_obstacle && in.obstacle_dist <= 0 && in.delta_cost_x > 0
+		&& planner.m_state == state_t::STATE_ROTATING && fabs(in.yaw_error) < M_PI / 6;
 }
 
 geometry_msgs::msg::TwistStamped NeoLocalPlanner::computeVelocityCommands(
@@ -174,193 +642,382 @@ geometry_msgs::msg::TwistStamped NeoLocalPlanner::computeVelocityCommands(
   const geometry_msgs::msg::Twist & speed)
 {
 	boost::mutex::scoped_lock lock(m_odometry_mutex);
+	placeControlThread();
 	geometry_msgs::msg::Twist cmd_vel;
 
-	if(m_global_plan.poses.empty())
+	if(m_global_plan.empty())
 	{
-		// ROS_WARN_NAMED("NeoLocalPlanner", "Global plan is empty!");
-		// return false;
+		m_log->logThrottled(log_throttle_period, AsyncLogger::LEVEL_WARN, "Global plan is empty!");
+		geometry_msgs::msg::TwistStamped cmd_vel_empty;
+		cmd_vel_empty.header.stamp = clock_->now();
+		cmd_vel_empty.header.frame_id = position.header.frame_id;
+		m_update_counter++;
+		return cmd_vel_empty;
 	}
 
 	// compute delta time
-	const rclcpp::Time time_now = rclcpp::Clock().now();
+	const rclcpp::Time time_now = clock_->now();
 	const double dt = fmax(fmin((time_now - m_last_time).seconds(), 0.1), 0);
 
-	// get latest global to local transform (map to odom)
-	tf2::Stamped<tf2::Transform> global_to_local;
-	try {
-		geometry_msgs::msg::TransformStamped msg = tf_->lookupTransform(m_local_frame, m_global_frame, tf2::TimePointZero);
-		tf2::fromMsg(msg, global_to_local);
-	} catch(...) {
-		// ROS_WARN_NAMED("NeoLocalPlanner", "lookupTransform(m_local_frame, m_global_frame) failed");
-		// return false;
-	std::cout<<"lookupTransform(m_local_frame, m_global_frame) failed"<<std::endl;
+	// check elapsed time against cycle budget, degrade further if behind
+	const auto cycle_begin = std::chrono::steady_clock::now();
+	int degrade_level = cycle_time_budget > 0 ? m_degrade_level : DEGRADE_NONE;
 
-	}
+	const auto check_deadline = [this, &cycle_begin, &degrade_level](double fraction)
+	{
+		const double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - cycle_begin).count();
+		if(cycle_time_budget > 0 && elapsed > fraction * cycle_time_budget) {
+			degrade_level = std::min(degrade_level + 1, int(NUM_DEGRADE_LEVELS) - 1);
+		}
+	};
 
-	// transform plan to local frame (odom)
-	std::vector<tf2::Transform> local_plan;
-	for(const auto& pose : m_global_plan.poses)
+	// telemetry for flight recorder
+	const state_t last_state = m_state;
+	flight_record_t record = {};
+	record.cycle = m_update_counter;
+	record.stamp = time_now.nanoseconds();
+
+	auto stage_begin = std::chrono::steady_clock::now();
+	const auto end_stage = [&stage_begin, &record](stage_t stage)
+	{
+		const auto now = std::chrono::steady_clock::now();
+		record.stage_time[stage] = std::chrono::duration_cast<std::chrono::nanoseconds>(now - stage_begin).count();
+		stage_begin = now;
+	};
+
+	// get latest global to local transform (map to odom)
+	SE2 global_to_local;
+	bool have_transform = false;
+	if(real_time_mode)
 	{
-		tf2::Transform pose_;
-		tf2::fromMsg(pose.pose, pose_);
-		local_plan.push_back(global_to_local * pose_);
+		// looked up by support task
+		have_transform = m_global_to_local.read(global_to_local) > 0;
+	}
+	else
+	{
+		try {
+			geometry_msgs::msg::TransformStamped msg = tf_->lookupTransform(m_local_frame, m_global_frame, tf2::TimePointZero);
+			tf2::Stamped<tf2::Transform> transform;
+			tf2::fromMsg(msg, transform);
+			global_to_local = to_se2(transform);
+			have_transform = true;
+		} catch(...) {
+			m_log->logThrottled(log_throttle_period, AsyncLogger::LEVEL_WARN, "lookupTransform(%s, %s) failed",
+								m_local_frame.c_str(), m_global_frame.c_str());
+		}
 	}
 
+	// keep goal in local frame for isGoalReached()
+	if(have_transform) {
+		updateGoal(global_to_local);
+	}
+
+	// plan queries are done in global frame (map)
+	const SE2 local_to_global = global_to_local.inverse();
+
 	// get latest local pose
-	tf2::Transform local_pose;
-	tf2::fromMsg(position.pose, local_pose);
+	SE2 local_pose = to_se2(position.pose);
 
-	const double start_yaw = tf2::getYaw(local_pose.getRotation());
 	const double start_vel_x = speed.linear.x;
 	const double start_vel_y = speed.linear.y;
 	const double start_yawrate = speed.angular.z;
 
+	// measure pipeline latency
+	const rclcpp::Time pose_time(position.header.stamp);
+	m_pose_latency = pose_time.nanoseconds() > 0 ? (time_now - pose_time).seconds() : 0;
+	m_odom_latency = m_odom_history_count > 0 ? (time_now - getOdometrySample(m_odom_history_count - 1).stamp).seconds() : 0;
+
+	// compensate latency by predicting pose at time of actuation
+	if(latency_compensation)
+	{
+		double delta_time = actuation_delay;
+
+		if(m_pose_latency > 0 && m_pose_latency <= max_latency)
+		{
+			delta_time += m_pose_latency;
+
+			// apply odometry motion since the pose was measured
+			odom_sample_t odom_at_pose;
+			if(interpolateOdometry(pose_time, odom_at_pose))
+			{
+				const odom_sample_t& latest = getOdometrySample(m_odom_history_count - 1);
+				const SE2 delta = SE2(odom_at_pose.x, odom_at_pose.y, odom_at_pose.yaw).inverse()
+									* SE2(latest.x, latest.y, latest.yaw);
+				local_pose = local_pose * delta;
+				delta_time -= fmax((latest.stamp - pose_time).seconds(), 0);
+			}
+		}
+
+		// extrapolate the rest (using second order midpoint method)
+		if(delta_time > 0)
+		{
+			local_pose = local_pose.predict(twist2_t(start_vel_x, start_vel_y, start_yawrate), delta_time);
+		}
+	}
+
 	// calc dynamic lookahead distances
 	const double lookahead_dist = m_lookahead_dist + fmax(start_vel_x, 0) * lookahead_time;
 	const double cost_y_lookahead_dist = m_cost_y_lookahead_dist + fmax(start_vel_x, 0) * cost_y_lookahead_time;
 
 	// predict future pose (using second order midpoint method)
-	tf2::Vector3 actual_pos;
-	double actual_yaw = 0;
+	const SE2 actual_pose = local_pose.predict(twist2_t(start_vel_x, start_vel_y, start_yawrate), lookahead_time);
+	const point2_t actual_pos = actual_pose.position();
+	const double actual_yaw = actual_pose.yaw();
+
+	// resample costmap around predicted pose, the perception task keeps using the costmap directly
+	const EgoCostGrid* ego_grid = nullptr;
+	if(m_ego_grid.getSize() > 0 && perception_rate <= 0)
 	{
-		const double midpoint_yaw = start_yaw + start_yawrate * lookahead_time / 2;
-		actual_pos = local_pose.getOrigin() + tf2::Matrix3x3(createQuaternionFromYaw(midpoint_yaw))
-												* tf2::Vector3(start_vel_x, start_vel_y, 0) * lookahead_time;
-		actual_yaw = start_yaw + start_yawrate * lookahead_time;
+		m_ego_grid.update(	costmap_->getCharMap(), costmap_->getSizeInCellsX(), costmap_->getSizeInCellsY(),
+							costmap_->getOriginX(), costmap_->getOriginY(), costmap_->getResolution(),
+							actual_pos.x, actual_pos.y, actual_yaw);
+		if(m_ego_grid.isValid()) {
+			ego_grid = &m_ego_grid;
+		}
 	}
 
+	record.pose[0] = actual_pos.x;
+	record.pose[1] = actual_pos.y;
+	record.pose[2] = actual_yaw;
+	record.pose_latency = m_pose_latency;
+	record.odom_latency = m_odom_latency;
+	end_stage(STAGE_PREDICT);
 
-	const tf2::Transform actual_pose = tf2::Transform(createQuaternionFromYaw(actual_yaw), actual_pos);
-
+	// cost gradients, obstacle scan and path search only depend on the predicted pose
+	const auto time_stage = [&record](stage_t stage, const auto& func)
+	{
+		const auto begin = std::chrono::steady_clock::now();
+		func();
+		record.stage_time[stage] = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - begin).count();
+	};
 
 	// compute cost gradients
-	const double delta_x = 0.3;
-	const double delta_y = 0.2;
-	const double delta_yaw = 0.1;
-
+	double center_cost = 0;
+	double delta_cost_x = m_last_delta_cost[0];
+	double delta_cost_y = m_last_delta_cost[1];
+	double delta_cost_yaw = m_last_delta_cost[2];
 
-	const double center_cost = get_cost(costmap_, actual_pos);
-	const double delta_cost_x = (
-		compute_avg_line_cost(costmap_, actual_pos, actual_pose * tf2::Vector3(delta_x, 0, 0)) -
-		compute_avg_line_cost(costmap_, actual_pos, actual_pose * tf2::Vector3(-delta_x, 0, 0)))
-		/ delta_x;
+	const auto compute_gradients = [&]()
+	{
+		center_cost = get_cost(costmap_, ego_grid, actual_pos);
+		double delta_cost[3] = {delta_cost_x, delta_cost_y, delta_cost_yaw};
+		computeGradients(actual_pose, cost_y_lookahead_dist,
+						degrade_level >= DEGRADE_REUSE_GRADIENTS && m_have_gradients,
+						degrade_level >= DEGRADE_FEWER_PROBES && m_have_gradients, delta_cost, ego_grid);
+		delta_cost_x = delta_cost[0];
+		delta_cost_y = delta_cost[1];
+		delta_cost_yaw = delta_cost[2];
+	};
 
-	const double delta_cost_y = (
-		compute_avg_line_cost(costmap_, actual_pos, actual_pose * tf2::Vector3(cost_y_lookahead_dist, delta_y, 0)) -
-		compute_avg_line_cost(costmap_, actual_pos, actual_pose * tf2::Vector3(cost_y_lookahead_dist, -delta_y, 0)))
-		/ delta_y;
+	// compute obstacle distance
+	obstacle_scan_t obstacle_scan = {};
 
-	const double delta_cost_yaw = (
-		(
-			compute_avg_line_cost(costmap_,	actual_pose * (tf2::Matrix3x3(createQuaternionFromYaw(delta_yaw)) * tf2::Vector3(delta_x, 0, 0)),
-												actual_pose * (tf2::Matrix3x3(createQuaternionFromYaw(delta_yaw)) * tf2::Vector3(-delta_x, 0, 0)))
-		) - (
-			compute_avg_line_cost(costmap_,	actual_pose * (tf2::Matrix3x3(createQuaternionFromYaw(-delta_yaw)) * tf2::Vector3(delta_x, 0, 0)),
-												actual_pose * (tf2::Matrix3x3(createQuaternionFromYaw(-delta_yaw)) * tf2::Vector3(-delta_x, 0, 0)))
-		)) / (2 * delta_yaw);
+	const auto scan_obstacles = [&]()
+	{
+		obstacle_scan = runObstacleScan(actual_pose, start_vel_x, start_yawrate, degrade_level, ego_grid);
+	};
 
-	// fill local plan later
-	nav_msgs::msg::Path local_path;
-	local_path.header.frame_id = m_local_frame;
-	local_path.header.stamp = m_odometry->header.stamp;
+	// find closest point on path to future position
+	const point2_t actual_pos_global = local_to_global * actual_pos;
+	bool is_goal_target = false;
+	double goal_dist = 0;
+	double yaw_error = 0;
+	point2_t pos_error;
 
-	// compute obstacle distance
-	bool have_obstacle = false;
-	double obstacle_dist = 0;
-	double obstacle_cost = 0;
+	const auto search_path = [&]()
 	{
-		const double delta_move = 0.05;
-		const double delta_time = start_vel_x > trans_stopped_vel ? (delta_move / start_vel_x) : 0;
+		size_t target_index = findClosestOnPlan(actual_pos_global.x, actual_pos_global.y);
+		m_plan_progress = target_index;
 
-		tf2::Transform pose = actual_pose;
-		tf2::Transform last_pose = pose;
-
-		while(obstacle_dist < 10)
+		// check if goal target
 		{
-			const double cost = compute_max_line_cost(costmap_, last_pose.getOrigin(), pose.getOrigin());
+			// check if goal is within reach
+			const size_t next_index = m_global_plan.moveAlong(target_index, max_goal_dist);
+			is_goal_target = next_index + 1 >= m_global_plan.size();
 
-			bool is_contained = false;
+			if(is_goal_target)
 			{
-				unsigned int dummy[2] = {};
-				is_contained = costmap_->worldToMap(pose.getOrigin().x(), pose.getOrigin().y(), dummy[0], dummy[1]);
+				// go straight to goal
+				target_index = next_index;
 			}
-			have_obstacle = cost >= max_cost;
-			obstacle_cost = fmax(obstacle_cost, cost);
+		}
+
+		// get target position
+		const point2_t target_pos = global_to_local * point2_t(m_global_plan.x[target_index], m_global_plan.y[target_index]);
+
+		// figure out target orientation
+		double target_yaw = 0;
 
+		if(is_goal_target)
+		{
+			// take goal orientation
+			target_yaw = global_to_local.yaw() + m_global_plan.yaw[target_index];
+		}
+		else
+		{
+			// compute path based target orientation
+			const size_t next_index = m_global_plan.moveAlong(target_index, lookahead_dist);
+			const point2_t next_pos = global_to_local * point2_t(m_global_plan.x[next_index], m_global_plan.y[next_index]);
+			target_yaw = ::atan2(	next_pos.y - target_pos.y,
+									next_pos.x - target_pos.x);
+		}
+
+		// compute errors
+		goal_dist = ::hypot(m_global_plan.x.back() - actual_pos_global.x, m_global_plan.y.back() - actual_pos_global.y);
+		yaw_error = angles::shortest_angular_distance(actual_yaw, target_yaw);
+		pos_error = actual_pose.inverseTransform(target_pos);
+	};
+
+	check_deadline(0.25);
+
+	if(perception_rate > 0)
+	{
+		// hand predicted pose to background stage and take its latest results
+		perception_input_t input;
+		input.pose = actual_pose;
+		input.start_vel_x = start_vel_x;
+		input.start_yawrate = start_yawrate;
+		input.cost_y_lookahead_dist = cost_y_lookahead_dist;
+		input.degrade_level = degrade_level;
+		m_perception_input.write(input);
+
+		time_stage(STAGE_GRADIENTS, [&]() {
+			m_perception_version = m_perception_output.read(m_perception, m_perception_version);
+			center_cost = get_cost(costmap_, ego_grid, actual_pos);
+		});
+
+		const bool is_stale = m_perception_version == 0
+				|| (time_now - m_perception.stamp).seconds() > perception_timeout;
+
+		time_stage(STAGE_SCAN, [&]() {
+			if(is_stale)
 			{
-				geometry_msgs::msg::PoseStamped tmp;
-				auto tmp1 = tf2::toMsg(pose);
-				tmp.header = position.header;
-				tmp.pose.position.x = tmp1.translation.x;
-				tmp.pose.position.y = tmp1.translation.y;
-				tmp.pose.position.z = tmp1.translation.z;
-				tmp.pose.orientation.x = tmp1.rotation.x;
-				tmp.pose.orientation.y = tmp1.rotation.y;
-				tmp.pose.orientation.z = tmp1.rotation.z;
-				tmp.pose.orientation.w = tmp1.rotation.w;
-				local_path.poses.push_back(tmp);
-			}
-			if(!is_contained || have_obstacle) {
-				break;
+				// treat missing perception like an obstacle right ahead
+				m_log->logThrottled(log_throttle_period, AsyncLogger::LEVEL_WARN,
+									"Perception results are outdated, stopping.");
+				delta_cost_x = 0;
+				delta_cost_y = 0;
+				delta_cost_yaw = 0;
+				obstacle_scan.have_obstacle = true;
+				obstacle_scan.obstacle_dist = min_stop_dist;
+				return;
 			}
+			delta_cost_x = m_perception.delta_cost[0];
+			delta_cost_y = m_perception.delta_cost[1];
+			delta_cost_yaw = m_perception.delta_cost[2];
+			obstacle_scan = m_perception.obstacle_scan;
 
-			last_pose = pose;
-			pose = tf2::Transform(createQuaternionFromYaw(tf2::getYaw(pose.getRotation()) + start_yawrate * delta_time),
-							pose * tf2::Vector3(delta_move, 0, 0));
+			// account for distance travelled along the scan since it was computed
+			if(obstacle_scan.have_obstacle && !m_perception.samples.empty())
+			{
+				double best_dist_sq = std::numeric_limits<double>::infinity();
+				double travelled = 0;
+				for(const auto& sample : m_perception.samples)
+				{
+					const double dist_sq = pow(sample.x - actual_pos.x, 2) + pow(sample.y - actual_pos.y, 2);
+					if(dist_sq < best_dist_sq) {
+						best_dist_sq = dist_sq;
+						travelled = sample.dist;
+					}
+				}
+				obstacle_scan.obstacle_dist -= travelled;
+			}
+		});
 
-			obstacle_dist += delta_move;
-		}
+		time_stage(STAGE_PATH, search_path);
+	}
+	else if(m_stage_pool)
+	{
+		// fan out to worker pool, each stage writes only its own outputs
+		m_stage_pool->parallelFor(3, [&](size_t i) {
+			switch(i) {
+				case 0: time_stage(STAGE_GRADIENTS, compute_gradients); break;
+				case 1: time_stage(STAGE_SCAN, scan_obstacles); break;
+				default: time_stage(STAGE_PATH, search_path);
+			}
+		});
+		// too late for the stages themselves, but control and the next cycle degrade
+		check_deadline(0.5);
+	}
+	else
+	{
+		time_stage(STAGE_GRADIENTS, compute_gradients);
+		check_deadline(0.5);
+		time_stage(STAGE_SCAN, scan_obstacles);
+		time_stage(STAGE_PATH, search_path);
 	}
-	m_local_plan_pub->publish(local_path);
-
-	obstacle_dist -= min_stop_dist;
+	stage_begin = std::chrono::steady_clock::now();
 
-	// publish local plan
+	m_last_delta_cost[0] = delta_cost_x;
+	m_last_delta_cost[1] = delta_cost_y;
+	m_last_delta_cost[2] = delta_cost_yaw;
+	m_have_gradients = true;
 
-	// compute situational max velocities
-	const double max_trans_vel = fmax(max_vel_trans * (max_cost - center_cost) / max_cost, min_vel_trans);
-	const double max_rot_vel = fmax(max_vel_theta * (max_cost - center_cost) / max_cost, min_vel_theta);
+	record.center_cost = center_cost;
+	record.delta_cost[0] = delta_cost_x;
+	record.delta_cost[1] = delta_cost_y;
+	record.delta_cost[2] = delta_cost_yaw;
 
-	// find closest point on path to future position
-	auto iter_target = find_closest_point(local_plan.cbegin(), local_plan.cend(), actual_pos);
+	const bool have_obstacle = obstacle_scan.have_obstacle;
+	double obstacle_dist = obstacle_scan.obstacle_dist;
 
-	// check if goal target
-	bool is_goal_target = false;
+	// speed limit from footprint clearance along the plan, one lookup at our progress
+	double plan_speed_limit = std::numeric_limits<double>::infinity();
+	if(m_speed_map.getCapacity() > 0 && have_transform)
 	{
-		// check if goal is within reach
-		auto iter_next = move_along_path(iter_target, local_plan.cend(), max_goal_dist);
-		is_goal_target = iter_next + 1 >= local_plan.cend();
-
-		if(is_goal_target)
-		{
-			// go straight to goal
-			iter_target = iter_next;
+		double dirty_bounds[4] = {};
+		getDirtyBounds(dirty_bounds);
+		m_speed_map.update(m_global_plan, m_plan_progress, global_to_local, costmap_, dirty_bounds);
+		plan_speed_limit = m_speed_map.getSpeedLimit(m_global_plan, m_plan_progress);
+
+		m_speed_map.encode(m_speed_map_data, speed_map_resolution);
+		if(real_time_mode) {
+			m_speed_map_output.write(m_speed_map_data);		// published by support task
+		} else if(m_speed_map_pub->is_activated()) {
+			m_speed_map_pub->publish(to_speed_map_msg(m_speed_map_data));
 		}
 	}
-	// figure out target orientation
-	double target_yaw = 0;
 
-	if(is_goal_target)
+	// publish local plan
+	const std::vector<scan_sample_t>& local_samples = perception_rate > 0 ? m_perception.samples : m_scan_samples;
+	if(real_time_mode)
 	{
-		// take goal orientation
-		target_yaw = tf2::getYaw(iter_target->getRotation());
+		// published by support task, buffer is preallocated
+		m_local_plan.stamp = m_odometry ? m_odometry->header.stamp : position.header.stamp;
+		m_local_plan.samples.assign(local_samples.begin(), local_samples.end());
+		m_local_plan_output.write(m_local_plan);
 	}
 	else
 	{
-		// compute path based target orientation
-		auto iter_next = move_along_path(iter_target, local_plan.cend(), lookahead_dist);
-		target_yaw = ::atan2(	iter_next->getOrigin().y() - iter_target->getOrigin().y(),
-								iter_next->getOrigin().x() - iter_target->getOrigin().x());
+		nav_msgs::msg::Path local_path;
+		local_path.header.frame_id = m_local_frame;
+		local_path.header.stamp = m_odometry ? m_odometry->header.stamp : position.header.stamp;
+
+		for(const auto& sample : local_samples)
+		{
+			geometry_msgs::msg::PoseStamped tmp;
+			tmp.header = position.header;
+			tmp.pose.position.x = sample.x;
+			tmp.pose.position.y = sample.y;
+			tmp.pose.orientation = tf2::toMsg(createQuaternionFromYaw(sample.yaw));
+			local_path.poses.push_back(tmp);
+		}
+		m_local_plan_pub->publish(local_path);
 	}
 
-	// get target position
-	const tf2::Vector3 target_pos = iter_target->getOrigin();
+	obstacle_dist -= min_stop_dist;
+
+	record.obstacle_dist = obstacle_dist;
+	record.flags |= have_obstacle ? RECORD_HAVE_OBSTACLE : 0;
+
+	// compute situational max velocities
+	const double max_trans_vel = fmax(max_vel_trans * (max_cost - center_cost) / max_cost, min_vel_trans);
+	const double max_rot_vel = fmax(max_vel_theta * (max_cost - center_cost) / max_cost, min_vel_theta);
 
-	// compute errors
-	const double goal_dist = (local_plan.back().getOrigin() - actual_pos).length();
-	const double yaw_error = angles::shortest_angular_distance(actual_yaw, target_yaw);
-	const tf2::Vector3 pos_error = tf2::Transform(createQuaternionFromYaw(actual_yaw), actual_pos).inverse() * target_pos;
+	record.pos_error[0] = pos_error.x;
+	record.pos_error[1] = pos_error.y;
+	record.yaw_error = yaw_error;
+	record.flags |= is_goal_target ? RECORD_GOAL_TARGET : 0;
 
 	// compute control values
 	bool is_emergency_brake = false;
@@ -371,7 +1028,7 @@ geometry_msgs::msg::TwistStamped NeoLocalPlanner::computeVelocityCommands(
 	if(is_goal_target)
 	{
 		// use term for final stopping position
-		control_vel_x = pos_error.x() * pos_x_gain;
+		control_vel_x = pos_error.x * pos_x_gain;
 	}
 	else
 	{
@@ -414,6 +1071,9 @@ geometry_msgs::msg::TwistStamped NeoLocalPlanner::computeVelocityCommands(
 			control_vel_x = fmin(control_vel_x, max_vel_x);
 		}
 
+		// limit velocity to what the footprint clearance along the plan allows
+		control_vel_x = fmin(control_vel_x, plan_speed_limit);
+
 		// stop before hitting obstacle
 		if(have_obstacle && obstacle_dist <= 0)
 		{
@@ -425,7 +1085,7 @@ geometry_msgs::msg::TwistStamped NeoLocalPlanner::computeVelocityCommands(
 	}
 	// limit backing up
 	if(is_goal_target && max_backup_dist > 0
-		&& pos_error.x() < (m_state == state_t::STATE_TURNING ? 0 : -1 * max_backup_dist))
+		&& pos_error.x < (m_state == state_t::STATE_TURNING ? 0 : -1 * max_backup_dist))
 	{
 		control_vel_x = 0;
 		m_state = state_t::STATE_TURNING;
@@ -435,116 +1095,103 @@ geometry_msgs::msg::TwistStamped NeoLocalPlanner::computeVelocityCommands(
 		m_state = state_t::STATE_IDLE;
 	}
 
-	if(differential_drive)
+	// drive model specific part
+	control_input_t control_input;
+	control_input.start_vel_x = start_vel_x;
+	control_input.start_yawrate = start_yawrate;
+	control_input.pos_error_x = pos_error.x;
+	control_input.pos_error_y = pos_error.y;
+	control_input.yaw_error = yaw_error;
+	control_input.delta_cost_x = delta_cost_x;
+	control_input.delta_cost_y = delta_cost_y;
+	control_input.delta_cost_yaw = delta_cost_yaw;
+	control_input.max_rot_vel = max_rot_vel;
+	control_input.obstacle_dist = obstacle_dist;
+	control_input.have_obstacle = have_obstacle;
+	control_input.is_goal_target = is_goal_target;
+
+	m_drive_model.apply(*this, control_input, control_vel_x, control_vel_y, control_yawrate);
+
+	// optionally replace reactive law by short horizon MPC
+	if(mpc_mode)
 	{
-		if(fabs(start_vel_x) > (m_state == state_t::STATE_TRANSLATING ?
-								trans_stopped_vel : 2 * trans_stopped_vel))
-		{
-			// we are translating, use term for lane keeping
-			control_yawrate = pos_error.y() / start_vel_x * pos_y_yaw_gain;
-
-			if(!is_goal_target)
-			{
-				// additional term for lane keeping
-				control_yawrate += yaw_error * yaw_gain;
-
-				// add cost terms
-				control_yawrate -= delta_cost_y / start_vel_x * cost_y_yaw_gain;
-				control_yawrate -= delta_cost_yaw * cost_yaw_gain;
-			}
+		// start where the reactive law looks from, i.e. after pose and control latency
+		computeMpcControl(actual_pose, local_to_global, global_to_local, max_trans_vel, max_rot_vel,
+							control_vel_x, control_vel_y, control_yawrate);
 
-			m_state = state_t::STATE_TRANSLATING;
-		}
-		else if(m_state == state_t::STATE_TURNING)
-		{
-			// continue on current yawrate
-			control_yawrate = (start_yawrate > 0 ? 1 : -1) * max_rot_vel;
-		}
-		else if(is_goal_target
-				&& (m_state == state_t::STATE_ADJUSTING || fabs(yaw_error) < M_PI / 6)
-				&& fabs(pos_error.y()) > (m_state == state_t::STATE_ADJUSTING ?
-					0.25 * xy_goal_tolerance : 0.5 * xy_goal_tolerance))
+		// same safety limits as above
+		if(have_obstacle && start_vel_x > 0)
 		{
-			// we are not translating, but we have too large y error
-			control_yawrate = (pos_error.y() > 0 ? 1 : -1) * max_rot_vel;
-
-			m_state = state_t::STATE_ADJUSTING;
+			const double stop_accel = 0.9 * acc_lim_x;
+			const double max_vel_x = stop_accel * sqrt(2 * fmax(obstacle_dist, 0) / stop_accel);
+			is_emergency_brake = is_emergency_brake || max_vel_x < 0.5 * start_vel_x;
+			control_vel_x = fmin(control_vel_x, max_vel_x);
 		}
-		else
-		{
-			// use term for static target orientation
-			control_yawrate = yaw_error * static_yaw_gain;
-
-			m_state = state_t::STATE_ROTATING;
+		if(have_obstacle && obstacle_dist <= 0) {
+			control_vel_x = fmin(control_vel_x, 0);
 		}
 	}
-	else
-	{
-		// simply correct y with holonomic drive
-		control_vel_y = pos_error.y() * pos_y_gain;
-
-		if(m_state == state_t::STATE_TURNING)
-		{
-			// continue on current yawrate
-			control_yawrate = (start_yawrate > 0 ? 1 : -1) * max_rot_vel;
-		}
-		else
-		{
-			// use term for static target orientation
-			control_yawrate = yaw_error * static_yaw_gain;
-
-			if(fabs(start_vel_x) > trans_stopped_vel) {
-				m_state = state_t::STATE_TRANSLATING;
-			} else {
-				m_state = state_t::STATE_ROTATING;
-			}
-		}
-
-		// apply x cost term only when rotating
-		if(m_state == state_t::STATE_ROTATING && fabs(yaw_error) > M_PI / 6)
-		{
-			control_vel_x -= delta_cost_x * cost_x_gain;
-		}
-
-		// apply y cost term when not approaching goal or if we are rotating
-		if(!is_goal_target || (m_state == state_t::STATE_ROTATING && fabs(yaw_error) > M_PI / 6))
-		{
-			control_vel_y -= delta_cost_y * cost_y_gain;
-		}
 
-		// apply yaw cost term when not approaching goal
-		if(!is_goal_target)
+	// footprint clearance limits the translational speed, scale x and y together
+	{
+		const double trans_vel = ::hypot(control_vel_x, control_vel_y);
+		if(trans_vel > plan_speed_limit)
 		{
-			control_yawrate -= delta_cost_yaw * cost_yaw_gain;
+			control_vel_x *= plan_speed_limit / trans_vel;
+			control_vel_y *= plan_speed_limit / trans_vel;
 		}
 	}
+
 	// check if we are stuck
-	if(have_obstacle && obstacle_dist <= 0 && delta_cost_x > 0
-		&& m_state == state_t::STATE_ROTATING && fabs(yaw_error) < M_PI / 6)
+	if(m_drive_model.is_stuck(*this, control_input))
 	{
 		// we are stuck
 		m_state = state_t::STATE_STUCK;
 
-		std::cout<<"We are stuck"<<std::endl;
-		// ROS_WARN_NAMED("NeoLocalPlanner", "We are stuck: yaw_error=%f, obstacle_dist=%f, obstacle_cost=%f, delta_cost_x=%f",
-						// yaw_error, obstacle_dist, obstacle_cost, delta_cost_x);
-		// return false;
+		m_log->logThrottled(log_throttle_period, AsyncLogger::LEVEL_WARN,
+							"We are stuck: yaw_error=%f, obstacle_dist=%f, obstacle_cost=%f, delta_cost_x=%f",
+							yaw_error, obstacle_dist, obstacle_scan.obstacle_cost, delta_cost_x);
 		geometry_msgs::msg::TwistStamped cmd_vel_stuck;
-  	cmd_vel_stuck.header.stamp = clock_->now();
+  	cmd_vel_stuck.header.stamp = time_now;
 		cmd_vel_stuck.header.frame_id = position.header.frame_id;
   	cmd_vel_stuck.twist.linear.x = 0;
   	cmd_vel_stuck.twist.angular.z = 0;
 
+		record.control_vel[0] = control_vel_x;
+		record.control_vel[1] = control_vel_y;
+		record.control_vel[2] = control_yawrate;
+		record.state = m_state;
+		record.degrade_level = degrade_level;
+		end_stage(STAGE_CONTROL);
+		updateDegradation(degrade_level, std::chrono::duration<double>(std::chrono::steady_clock::now() - cycle_begin).count());
+
+		if(m_flight_recorder)
+		{
+			m_flight_recorder->add(record);
+			if(last_state != state_t::STATE_STUCK) {
+				dumpFlightRecord(DUMP_STUCK);
+			}
+		}
+		m_update_counter++;
+
   return cmd_vel_stuck;
 	}
 
 	// logic check
 	is_emergency_brake = is_emergency_brake && control_vel_x >= 0;
 
-	// apply low pass filter
-	control_vel_x = control_vel_x * low_pass_gain + m_last_control_values[0] * (1 - low_pass_gain);
-	control_vel_y = control_vel_y * low_pass_gain + m_last_control_values[1] * (1 - low_pass_gain);
-	control_yawrate = control_yawrate * low_pass_gain + m_last_control_values[2] * (1 - low_pass_gain);
+	record.control_vel[0] = control_vel_x;
+	record.control_vel[1] = control_vel_y;
+	record.control_vel[2] = control_yawrate;
+	record.flags |= is_emergency_brake ? RECORD_EMERGENCY_BRAKE : 0;
+
+	// apply low pass filter (MPC output is smooth already)
+	if(!mpc_mode)
+	{
+		control_vel_x = control_vel_x * low_pass_gain + m_last_control_values[0] * (1 - low_pass_gain);
+		control_vel_y = control_vel_y * low_pass_gain + m_last_control_values[1] * (1 - low_pass_gain);
+		control_yawrate = control_yawrate * low_pass_gain + m_last_control_values[2] * (1 - low_pass_gain);
+	}
 
 	// apply acceleration limits
 	control_vel_x = fmax(fmin(control_vel_x, m_last_cmd_vel.linear.x + acc_lim_x * dt),
@@ -580,9 +1227,29 @@ geometry_msgs::msg::TwistStamped NeoLocalPlanner::computeVelocityCommands(
 	cmd_vel.angular.z = fmin(fmax(control_yawrate, -max_vel_theta), max_vel_theta);
 
 	if(m_update_counter % 20 == 0) {
-		// ROS_INFO_NAMED("NeoLocalPlanner", "dt=%f, pos_error=(%f, %f), yaw_error=%f, cost=%f, obstacle_dist=%f, obstacle_cost=%f, delta_cost=(%f, %f, %f), state=%d, cmd_vel=(%f, %f), cmd_yawrate=%f",
-						// dt, pos_error.x(), pos_error.y(), yaw_error, center_cost, obstacle_dist, obstacle_cost, delta_cost_x, delta_cost_y, delta_cost_yaw, m_state, control_vel_x, control_vel_y, control_yawrate);
+		m_log->log(AsyncLogger::LEVEL_DEBUG, "dt=%f, pos_error=(%f, %f), yaw_error=%f, cost=%f, obstacle_dist=%f, obstacle_cost=%f, "
+					"delta_cost=(%f, %f, %f), state=%d, cmd_vel=(%f, %f), cmd_yawrate=%f, pose_latency=%f, odom_latency=%f",
+					dt, pos_error.x, pos_error.y, yaw_error, center_cost, obstacle_dist, obstacle_scan.obstacle_cost,
+					delta_cost_x, delta_cost_y, delta_cost_yaw, int(m_state), control_vel_x, control_vel_y, control_yawrate,
+					m_pose_latency, m_odom_latency);
+	}
+	record.cmd_vel[0] = cmd_vel.linear.x;
+	record.cmd_vel[1] = cmd_vel.linear.y;
+	record.cmd_vel[2] = cmd_vel.angular.z;
+	record.state = m_state;
+	record.degrade_level = degrade_level;
+	end_stage(STAGE_CONTROL);
+	updateDegradation(degrade_level, std::chrono::duration<double>(std::chrono::steady_clock::now() - cycle_begin).count());
+
+	if(m_flight_recorder)
+	{
+		m_flight_recorder->add(record);
+		if(is_emergency_brake && !m_last_emergency_brake) {
+			dumpFlightRecord(DUMP_EMERGENCY_BRAKE);
+		}
 	}
+	m_last_emergency_brake = is_emergency_brake;
+
 	m_last_time = time_now;
 	m_last_control_values[0] = control_vel_x;
 	m_last_control_values[1] = control_vel_y;
@@ -591,7 +1258,7 @@ geometry_msgs::msg::TwistStamped NeoLocalPlanner::computeVelocityCommands(
 
 	m_update_counter++;
 	geometry_msgs::msg::TwistStamped cmd_vel_final;
-  	cmd_vel_final.header.stamp = clock_->now();
+  	cmd_vel_final.header.stamp = time_now;
 	cmd_vel_final.header.frame_id = position.header.frame_id;
   	cmd_vel_final.twist.linear = cmd_vel.linear;
   	cmd_vel_final.twist.angular = cmd_vel.angular;
@@ -599,96 +1266,419 @@ geometry_msgs::msg::TwistStamped NeoLocalPlanner::computeVelocityCommands(
   return cmd_vel_final;
 }
 
+NeoLocalPlanner::batch_stats_t NeoLocalPlanner::computeVelocityCommandsBatch(std::vector<batch_item_t>& batch, WorkerPool& pool)
+{
+	const auto time_begin = std::chrono::steady_clock::now();
+
+	// the calling thread helps out, it belongs to the caller like the pool workers
+	struct batch_scope_t {
+		batch_scope_t() { g_batch_depth++; }
+		~batch_scope_t() { g_batch_depth--; }
+	} batch_scope;
+
+	pool.parallelFor(batch.size(), [&batch](size_t i) {
+		batch_item_t& item = batch[i];
+		item.cmd_vel = item.planner->computeVelocityCommands(item.pose, item.speed);
+	});
+
+	batch_stats_t stats;
+	stats.num_items = batch.size();
+	stats.num_threads = pool.numThreads();
+	stats.wall_time = std::chrono::duration<double>(std::chrono::steady_clock::now() - time_begin).count();
+	if(stats.wall_time > 0) {
+		stats.cycles_per_core = stats.num_items / stats.wall_time / std::max(stats.num_threads, 1);
+	}
+	return stats;
+}
+
+size_t NeoLocalPlanner::findClosestOnPlan(double x, double y) const
+{
+	// search around last progress on plan, unless we are too far off
+	if(plan_search_window > 0)
+	{
+		double dist = 0;
+		const size_t index = m_global_plan.findClosestInWindow(x, y, m_plan_progress, 0.2 * plan_search_window, plan_search_window, &dist);
+		if(dist <= 0.5 * plan_search_window) {
+			return index;
+		}
+	}
+	return m_global_plan.findClosest(x, y, 0, m_global_plan.size());
+}
+
+double NeoLocalPlanner::sampleCost(double x, double y, double* grad) const
+{
+	// bilinear interpolation between cell centers
+	const double resolution = costmap_->getResolution();
+	const double fx = (x - costmap_->getOriginX()) / resolution - 0.5;
+	const double fy = (y - costmap_->getOriginY()) / resolution - 0.5;
+	const int ix = int(::floor(fx));
+	const int iy = int(::floor(fy));
+
+	grad[0] = 0;
+	grad[1] = 0;
+	if(ix < 0 || iy < 0 || ix + 1 >= int(costmap_->getSizeInCellsX()) || iy + 1 >= int(costmap_->getSizeInCellsY())) {
+		return 0;
+	}
+	const double ax = fx - ix;
+	const double ay = fy - iy;
+	const double c00 = costmap_->getCost(ix, iy) / 255.;
+	const double c10 = costmap_->getCost(ix + 1, iy) / 255.;
+	const double c01 = costmap_->getCost(ix, iy + 1) / 255.;
+	const double c11 = costmap_->getCost(ix + 1, iy + 1) / 255.;
+
+	grad[0] = ((1 - ay) * (c10 - c00) + ay * (c11 - c01)) / resolution;
+	grad[1] = ((1 - ax) * (c01 - c00) + ax * (c11 - c10)) / resolution;
+	return (1 - ax) * (1 - ay) * c00 + ax * (1 - ay) * c10 + (1 - ax) * ay * c01 + ax * ay * c11;
+}
+
+void NeoLocalPlanner::computeMpcControl(const SE2& start_pose,
+										const SE2& local_to_global,
+										const SE2& global_to_local,
+										double max_trans_vel, double max_rot_vel,
+										double& control_vel_x, double& control_vel_y, double& control_yawrate)
+{
+	const MpcSolver::params_t& params = m_mpc.getParams();
+	const double global_to_local_yaw = global_to_local.yaw();
+
+	// reference moves along the path at max velocity, stops at the goal
+	const point2_t start_pos_global = local_to_global * start_pose.position();
+	const size_t start_index = findClosestOnPlan(start_pos_global.x, start_pos_global.y);
+
+	for(size_t k = 0; k < m_mpc_reference.size(); ++k)
+	{
+		const size_t index = m_global_plan.moveAlong(start_index, max_trans_vel * k * params.dt);
+		const point2_t pos = global_to_local * point2_t(m_global_plan.x[index], m_global_plan.y[index]);
+
+		MpcSolver::pose_t& ref = m_mpc_reference[k];
+		ref.x = pos.x;
+		ref.y = pos.y;
+
+		if(index + 1 >= m_global_plan.size()) {
+			ref.yaw = global_to_local_yaw + m_global_plan.yaw[index];
+		} else {
+			const size_t next_index = m_global_plan.moveAlong(index, m_lookahead_dist);
+			const point2_t next_pos = global_to_local * point2_t(m_global_plan.x[next_index], m_global_plan.y[next_index]);
+			ref.yaw = ::atan2(next_pos.y - pos.y, next_pos.x - pos.x);
+		}
+	}
+
+	MpcSolver::control_t min_vel;
+	MpcSolver::control_t max_vel;
+	min_vel.vx = min_vel_x;
+	max_vel.vx = fmin(max_vel_x, max_trans_vel);
+	min_vel.vy = m_drive_model.has_lateral_vel ? min_vel_y : 0;
+	max_vel.vy = m_drive_model.has_lateral_vel ? max_vel_y : 0;
+	min_vel.yawrate = -max_rot_vel;
+	max_vel.yawrate = max_rot_vel;
+	m_mpc.setVelocityLimits(min_vel, max_vel);
+
+	MpcSolver::pose_t start;
+	start.x = start_pose.x();
+	start.y = start_pose.y();
+	start.yaw = start_pose.yaw();
+
+	MpcSolver::control_t start_vel;
+	start_vel.vx = m_last_cmd_vel.linear.x;
+	start_vel.vy = m_last_cmd_vel.linear.y;
+	start_vel.yawrate = m_last_cmd_vel.angular.z;
+
+	const MpcSolver::control_t control = m_mpc.solve(start, start_vel, m_mpc_reference,
+			[this](double x, double y, double* grad) { return sampleCost(x, y, grad); });
+
+	control_vel_x = control.vx;
+	control_vel_y = control.vy;
+	control_yawrate = control.yawrate;
+}
+
+void NeoLocalPlanner::updateDegradation(int level, double cycle_time)
+{
+	if(cycle_time_budget <= 0) {
+		return;
+	}
+	m_degrade_counts[level]++;
+
+	// start next cycle one level higher if we missed the budget, go back down slowly
+	if(cycle_time > cycle_time_budget)
+	{
+		m_degrade_level = std::min(level + 1, int(NUM_DEGRADE_LEVELS) - 1);
+		m_num_fast_cycles = 0;
+	}
+	else if(cycle_time < 0.5 * cycle_time_budget && m_degrade_level > DEGRADE_NONE)
+	{
+		if(++m_num_fast_cycles >= 20) {
+			m_degrade_level--;
+			m_num_fast_cycles = 0;
+		}
+	}
+
+	if(m_update_counter % 20 == 0)
+	{
+		if(real_time_mode)
+		{
+			// published by support task
+			std::array<uint64_t, NUM_DEGRADE_LEVELS> counts;
+			std::copy(m_degrade_counts, m_degrade_counts + NUM_DEGRADE_LEVELS, counts.begin());
+			m_degrade_counts_output.write(counts);
+		}
+		else if(m_degrade_pub && m_degrade_pub->is_activated())
+		{
+			std_msgs::msg::UInt64MultiArray msg;
+			msg.data.assign(m_degrade_counts, m_degrade_counts + NUM_DEGRADE_LEVELS);
+			m_degrade_pub->publish(msg);
+		}
+	}
+}
+
+void NeoLocalPlanner::dumpFlightRecord(dump_reason_t reason)
+{
+	static const char* reasons[] = {"requested", "stuck", "emergency brake"};
+
+	if(m_flight_recorder->dump(reason)) {
+		m_log->log(AsyncLogger::LEVEL_INFO, "Flight record dumped to %s (%s)",
+					m_flight_recorder->getFilePath().c_str(), reasons[reason]);
+	} else {
+		m_log->logThrottled(log_throttle_period, AsyncLogger::LEVEL_WARN, "Flight record could not be dumped to %s",
+							m_flight_recorder->getFilePath().c_str());
+	}
+}
+
+void NeoLocalPlanner::dumpServiceCallback(	const std::shared_ptr<std_srvs::srv::Trigger::Request> request,
+											std::shared_ptr<std_srvs::srv::Trigger::Response> response)
+{
+	(void)request;
+	boost::mutex::scoped_lock lock(m_odometry_mutex);
+
+	if(!m_flight_recorder) {
+		response->success = false;
+		response->message = "Flight recorder is disabled";
+		return;
+	}
+	response->success = m_flight_recorder->dump(DUMP_REQUESTED);
+	response->message = m_flight_recorder->getFilePath();
+}
+
+NeoLocalPlanner::~NeoLocalPlanner()
+{
+	m_perception_task.stop();
+	m_support_task.stop();
+}
+
 void NeoLocalPlanner::cleanup()
 {
+	m_perception_task.stop();
+	m_support_task.stop();
 	m_local_plan_pub.reset();
+	m_degrade_pub.reset();
+	m_speed_map_pub.reset();
+	m_dump_service.reset();
+	m_stage_pool.reset();
+	m_scan_templates.reset();
 }
 
 void NeoLocalPlanner::activate()
 {
 	m_local_plan_pub->on_activate();
+	m_degrade_pub->on_activate();
+	if(m_speed_map_pub) {
+		m_speed_map_pub->on_activate();
+	}
+
+	if(perception_rate > 0)
+	{
+		m_perception_input.clear();
+		m_perception_output.clear();
+		m_perception_version = 0;
+		m_perception_input_version = 0;
+		std::string error;
+		if(!m_perception_task.start(1 / perception_rate, std::bind(&NeoLocalPlanner::perceptionUpdate, this), worker_thread, error)) {
+			RCLCPP_WARN(logger_, "Perception thread placement failed: %s", error.c_str());
+		}
+	}
+	if(real_time_mode)
+	{
+		m_global_to_local.clear();
+		m_support_local_plan_version = 0;
+		m_support_degrade_counts_version = 0;
+		m_support_speed_map_version = 0;
+		std::string error;
+		if(!m_support_task.start(0.02, std::bind(&NeoLocalPlanner::supportUpdate, this), worker_thread, error)) {
+			RCLCPP_WARN(logger_, "Support thread placement failed: %s", error.c_str());
+		}
+	}
 }
 
 void NeoLocalPlanner::deactivate()
 {
 	m_local_plan_pub->on_deactivate();
+	m_degrade_pub->on_deactivate();
+	if(m_speed_map_pub) {
+		m_speed_map_pub->on_deactivate();
+	}
+	m_perception_task.stop();
+	m_support_task.stop();
+
+	// the controller server thread is not ours, hand it back as we found it
+	boost::mutex::scoped_lock lock(m_odometry_mutex);
+	restoreControlThread();
 }
 
 bool NeoLocalPlanner::isGoalReached()
 {
-	boost::mutex::scoped_lock lock(m_odometry_mutex);
+	// only touches lock-free state, plan and transforms are owned by the control loop
+	goal_state_t goal;
+	if(!m_goal_state.read(goal) || !goal.have_plan)
+	{
+		m_log->logThrottled(log_throttle_period, AsyncLogger::LEVEL_INFO, "Global Plan is empty");
+		return true;
+	}
 
-	nav2_core::GoalChecker *goal_checker; 
+	odom_state_t odom;
+	if(!m_odom_state.read(odom))
+	{
+		m_log->logThrottled(log_throttle_period, AsyncLogger::LEVEL_INFO, "Waiting for Odometry");
+		return false;
+	}
+	if(!goal.have_goal) {
+		return false;
+	}
 
-	geometry_msgs::msg::Pose current_pose; 
-	geometry_msgs::msg::Twist current_twist;
+	const double xy_error = ::hypot(odom.x - goal.x, odom.y - goal.y);
+	const double yaw_error = fabs(angles::shortest_angular_distance(odom.yaw, goal.yaw));
+	const bool is_reached = xy_error <= xy_goal_tolerance && yaw_error <= yaw_goal_tolerance;
+	const int64_t time_now = clock_->now().nanoseconds();
 
-	if(!m_odometry)
+	if(!m_is_goal_reached)
 	{
-		std::cout<< "Waiting for Odometry" << std::endl;
-		return false;
+		if(is_reached) {
+			m_log->log(AsyncLogger::LEVEL_INFO, "Goal reached: xy_error=%f [m], yaw_error=%f [rad]", xy_error, yaw_error);
+		}
+		m_first_goal_reached_time = time_now;
 	}
-	if(m_global_plan.poses.empty())
+	m_is_goal_reached = is_reached;
+	return is_reached && (time_now - m_first_goal_reached_time) * 1e-9 >= goal_tune_time;
+}
+
+void NeoLocalPlanner::updateGoal(const SE2& global_to_local)
+{
+	goal_state_t goal;
+	goal.have_plan = !m_global_plan.empty();
+	if(goal.have_plan)
 	{
-		std::cout<< "Global Plan is empty" << std::endl;
-		return true;
+		const point2_t goal_pos = global_to_local * point2_t(m_global_plan.x.back(), m_global_plan.y.back());
+		goal.x = goal_pos.x;
+		goal.y = goal_pos.y;
+		goal.yaw = global_to_local.yaw() + m_global_plan.yaw.back();
+		goal.have_goal = true;
 	}
+	m_goal_state.write(goal);
+}
 
-	tf2::Stamped<tf2::Transform> global_to_local;
-	try {
-		auto msg = tf_->lookupTransform(m_local_frame, m_global_frame,  tf2::TimePointZero);
-		tf2::fromMsg(msg, global_to_local);
-	} catch(...) {
-		std::cout<< "lookupTransform Failed!" << std::endl;
-		return false;
+void NeoLocalPlanner::placeControlThread()
+{
+	if(control_thread.isDefault() || WorkerPool::isWorkerThread() || g_batch_depth > 0) {
+		return;
+	}
+	if(m_is_control_thread_placed && get_thread_id() == m_control_thread_state.tid) {
+		return;
+	}
+	restoreControlThread();
+
+	std::string error;
+	if(!save_thread_state(m_control_thread_state, error)) {
+		m_log->log(AsyncLogger::LEVEL_WARN, "Control thread not placed: %s", error.c_str());
+		return;
 	}
+	m_is_control_thread_placed = true;
 
-	tf2::Stamped<tf2::Transform> goal_pose_global;
-	tf2::fromMsg(m_global_plan.poses.back(), goal_pose_global);
-	// geometry_msgs::msg::Transform goal_pose_global_check;
-	geometry_msgs::msg::Pose goal_pose_global_check1;
+	if(!apply_thread_config(::pthread_self(), control_thread, error)) {
+		m_log->log(AsyncLogger::LEVEL_WARN, "Control thread placement failed: %s", error.c_str());
+	}
+	const size_t prefault_size = prefault_stack(control_thread.prefault_stack);
+	if(prefault_size < control_thread.prefault_stack) {
+		m_log->log(AsyncLogger::LEVEL_WARN, "Control thread stack only has room to prefault %zu bytes", prefault_size);
+	}
+}
 
-	auto goal_pose_global_check = tf2::toMsg(goal_pose_global);
-	goal_pose_global_check1.position.x = goal_pose_global_check.transform.translation.x;
-	goal_pose_global_check1.position.y = goal_pose_global_check.transform.translation.y;
-	goal_pose_global_check1.position.z = goal_pose_global_check.transform.translation.z;
-	goal_pose_global_check1.orientation.x = goal_pose_global_check.transform.rotation.x;
-	goal_pose_global_check1.orientation.y = goal_pose_global_check.transform.rotation.y;
-	goal_pose_global_check1.orientation.z = goal_pose_global_check.transform.rotation.z;
-	goal_pose_global_check1.orientation.w = goal_pose_global_check.transform.rotation.w;
-	const auto goal_pose_local = global_to_local * goal_pose_global;
+void NeoLocalPlanner::restoreControlThread()
+{
+	if(!m_is_control_thread_placed) {
+		return;
+	}
+	m_is_control_thread_placed = false;
 
-	// Checking is goal_reached
-	current_pose.position = m_odometry->pose.pose.position;
-	current_pose.orientation = m_odometry->pose.pose.orientation;
-	current_twist.linear = m_odometry->twist.twist.linear;
-	current_twist.angular = m_odometry->twist.twist.angular;
+	std::string error;
+	if(!restore_thread_state(m_control_thread_state, error)) {
+		m_log->log(AsyncLogger::LEVEL_WARN, "Restoring control thread failed: %s", error.c_str());
+	}
+	m_control_thread_state = thread_state_t();
+}
 
-	const bool is_reached = goal_checker->isGoalReached(goal_pose_global_check1, current_pose, current_twist);
+void NeoLocalPlanner::setPlan(const nav_msgs::msg::Path & plan)
+{
+	std::vector<plan_point_t> points(plan.poses.size());
+	for(size_t i = 0; i < plan.poses.size(); ++i)
+	{
+		points[i].x = plan.poses[i].pose.position.x;
+		points[i].y = plan.poses[i].pose.position.y;
+		points[i].yaw = tf2::getYaw(plan.poses[i].pose.orientation);
+	}
 
-	const double xy_error = ::hypot(m_odometry->pose.pose.position.x - goal_pose_local.getOrigin().x(),
-									m_odometry->pose.pose.position.y - goal_pose_local.getOrigin().y());
-	
-	const double yaw_error = fabs(angles::shortest_angular_distance(tf2::getYaw(m_odometry->pose.pose.orientation),
-																	tf2::getYaw(goal_pose_local.getRotation())));
+	preprocess_stats_t stats;
+	const std::vector<plan_point_t> new_plan = preprocess_plan(std::move(points), plan_preprocessing, &stats);
+
+	// keep what the new plan shares with the old one, so that tracking continues where it was
+	// (like preprocessing, this is still linear in the plan length)
+	PlanStorage::splice_t splice;
+	bool is_spliced = false;
+	if(plan_splice_tolerance > 0) {
+		// the robot is near m_plan_progress, so is the start of a replanned path
+		is_spliced = m_global_plan.splice(	new_plan, plan_splice_tolerance, plan_splice_yaw_tolerance,
+											m_plan_progress, plan_search_window, &splice);
+	} else {
+		m_global_plan.assign(new_plan);
+	}
+	m_plan_progress = is_spliced ? PlanStorage::mapIndex(splice, m_global_plan.size(), m_plan_progress, 0) : 0;
 
-	if(!m_is_goal_reached)
+	// goal is updated every cycle, but we may be asked before the first one
 	{
-		if(is_reached) {
-			std::cout<<"Goal reached: xy_error=" << xy_error << " [m], yaw_error=" << yaw_error << " [rad]"<<std::endl;
+		boost::mutex::scoped_lock lock(m_odometry_mutex);
+
+		goal_state_t goal;
+		goal.have_plan = !m_global_plan.empty();
+		m_goal_state.write(goal);
+		try {
+			tf2::Stamped<tf2::Transform> global_to_local;
+			tf2::fromMsg(tf_->lookupTransform(m_local_frame, m_global_frame, tf2::TimePointZero), global_to_local);
+			updateGoal(to_se2(global_to_local));
+		} catch(...) {
+			// try again in computeVelocityCommands()
 		}
-		m_first_goal_reached_time =  rclcpp::Clock().now();
 	}
-	m_is_goal_reached = is_reached;
-	return is_reached && ( rclcpp::Clock().now() - m_first_goal_reached_time).seconds() >= goal_tune_time;
+	if(!is_spliced) {
+		m_mpc.reset();
+	}
+	m_speed_map.invalidate();
+	if(costmap_ros_) {
+		m_speed_map.setFootprint(costmap_ros_->getRobotFootprint());
+	}
+
+	RCLCPP_DEBUG(logger_, "setPlan(): preprocessed %zu to %zu poses in %f ms, using %zu bytes",
+				stats.num_input, stats.num_output, stats.runtime * 1e3, m_global_plan.memoryUsage());
+	if(is_spliced) {
+		RCLCPP_DEBUG(logger_, "setPlan(): kept %zu + %zu poses of previous plan, replaced %zu",
+					splice.prefix, splice.suffix, m_global_plan.size() - splice.prefix - splice.suffix);
+	}
 }
 
-void NeoLocalPlanner::setPlan(const nav_msgs::msg::Path & plan)
+void NeoLocalPlanner::configure(const rclcpp_lifecycle::LifecycleNode::SharedPtr & parent,  std::string name, const std::shared_ptr<tf2_ros::Buffer> & tf,  const std::shared_ptr<nav2_costmap_2d::Costmap2DROS> & costmap_ros)
 {
-	m_global_plan = plan;
+	configure(parent, name, tf, costmap_ros->getCostmap(), costmap_ros->getBaseFrameID(), costmap_ros->getRobotFootprint());
+	costmap_ros_ = costmap_ros;
 }
 
-void NeoLocalPlanner::configure(const rclcpp_lifecycle::LifecycleNode::SharedPtr & parent,  std::string name, const std::shared_ptr<tf2_ros::Buffer> & tf,  const std::shared_ptr<nav2_costmap_2d::Costmap2DROS> & costmap_ros)
+void NeoLocalPlanner::configure(const rclcpp_lifecycle::LifecycleNode::SharedPtr & parent,  std::string name, const std::shared_ptr<tf2_ros::Buffer> & tf,
+								nav2_costmap_2d::Costmap2D* costmap, const std::string& base_frame,
+								const nav2_costmap_2d::Footprint& footprint)
 {
 	plugin_name_ = name;
 	clock_ = parent->get_clock();
@@ -734,6 +1724,55 @@ void NeoLocalPlanner::configure(const rclcpp_lifecycle::LifecycleNode::SharedPtr
 	nav2_util::declare_parameter_if_not_declared(parent,plugin_name_ + ".emergency_acc_lim_x",rclcpp::ParameterValue(0.2));
 	nav2_util::declare_parameter_if_not_declared(parent,plugin_name_ + ".differential_drive", rclcpp::ParameterValue(true));
 	nav2_util::declare_parameter_if_not_declared(parent,plugin_name_ + ".constrain_final", rclcpp::ParameterValue(false));
+	nav2_util::declare_parameter_if_not_declared(parent,plugin_name_ + ".scan_reuse_tolerance", rclcpp::ParameterValue(0.02));
+	nav2_util::declare_parameter_if_not_declared(parent,plugin_name_ + ".scan_refresh_cycles", rclcpp::ParameterValue(10));
+	nav2_util::declare_parameter_if_not_declared(parent,plugin_name_ + ".latency_compensation", rclcpp::ParameterValue(false));
+	nav2_util::declare_parameter_if_not_declared(parent,plugin_name_ + ".actuation_delay", rclcpp::ParameterValue(0.0));
+	nav2_util::declare_parameter_if_not_declared(parent,plugin_name_ + ".max_latency", rclcpp::ParameterValue(0.1));
+	nav2_util::declare_parameter_if_not_declared(parent,plugin_name_ + ".odom_history_size", rclcpp::ParameterValue(50));
+	nav2_util::declare_parameter_if_not_declared(parent,plugin_name_ + ".plan_dedupe_dist", rclcpp::ParameterValue(0.001));
+	nav2_util::declare_parameter_if_not_declared(parent,plugin_name_ + ".plan_simplify_tolerance", rclcpp::ParameterValue(0.0));
+	nav2_util::declare_parameter_if_not_declared(parent,plugin_name_ + ".plan_simplify_max_angle", rclcpp::ParameterValue(M_PI / 2));
+	nav2_util::declare_parameter_if_not_declared(parent,plugin_name_ + ".plan_resample_step", rclcpp::ParameterValue(0.0));
+	nav2_util::declare_parameter_if_not_declared(parent,plugin_name_ + ".log_throttle_period", rclcpp::ParameterValue(1.0));
+	nav2_util::declare_parameter_if_not_declared(parent,plugin_name_ + ".flight_recorder_size", rclcpp::ParameterValue(1000));
+	// several nodes or processes may load a planner with the same name
+	const std::string default_flight_recorder_file = "/tmp/" + std::string(parent->get_name()) + "_" + plugin_name_
+													+ "_" + std::to_string(::getpid()) + "_flight_record.bin";
+	nav2_util::declare_parameter_if_not_declared(parent,plugin_name_ + ".flight_recorder_file", rclcpp::ParameterValue(default_flight_recorder_file));
+	nav2_util::declare_parameter_if_not_declared(parent,plugin_name_ + ".cycle_time_budget", rclcpp::ParameterValue(0.0));
+	nav2_util::declare_parameter_if_not_declared(parent,plugin_name_ + ".parallel_stages", rclcpp::ParameterValue(false));
+	nav2_util::declare_parameter_if_not_declared(parent,plugin_name_ + ".num_stage_threads", rclcpp::ParameterValue(0));
+	nav2_util::declare_parameter_if_not_declared(parent,plugin_name_ + ".perception_rate", rclcpp::ParameterValue(0.0));
+	nav2_util::declare_parameter_if_not_declared(parent,plugin_name_ + ".perception_timeout", rclcpp::ParameterValue(0.5));
+	nav2_util::declare_parameter_if_not_declared(parent,plugin_name_ + ".real_time_mode", rclcpp::ParameterValue(false));
+	nav2_util::declare_parameter_if_not_declared(parent,plugin_name_ + ".scan_templates", rclcpp::ParameterValue(false));
+	nav2_util::declare_parameter_if_not_declared(parent,plugin_name_ + ".plan_search_window", rclcpp::ParameterValue(5.0));
+	nav2_util::declare_parameter_if_not_declared(parent,plugin_name_ + ".plan_splice_tolerance", rclcpp::ParameterValue(0.01));
+	nav2_util::declare_parameter_if_not_declared(parent,plugin_name_ + ".plan_splice_yaw_tolerance", rclcpp::ParameterValue(0.01));
+	nav2_util::declare_parameter_if_not_declared(parent,plugin_name_ + ".ego_grid_size", rclcpp::ParameterValue(0));
+	nav2_util::declare_parameter_if_not_declared(parent,plugin_name_ + ".speed_map_dist", rclcpp::ParameterValue(0.0));
+	nav2_util::declare_parameter_if_not_declared(parent,plugin_name_ + ".speed_map_step", rclcpp::ParameterValue(0.1));
+	nav2_util::declare_parameter_if_not_declared(parent,plugin_name_ + ".speed_map_refresh_cycles", rclcpp::ParameterValue(10));
+	nav2_util::declare_parameter_if_not_declared(parent,plugin_name_ + ".mpc_mode", rclcpp::ParameterValue(false));
+	nav2_util::declare_parameter_if_not_declared(parent,plugin_name_ + ".mpc_horizon", rclcpp::ParameterValue(10));
+	nav2_util::declare_parameter_if_not_declared(parent,plugin_name_ + ".mpc_dt", rclcpp::ParameterValue(0.1));
+	nav2_util::declare_parameter_if_not_declared(parent,plugin_name_ + ".mpc_iterations", rclcpp::ParameterValue(20));
+	nav2_util::declare_parameter_if_not_declared(parent,plugin_name_ + ".mpc_weight_pos", rclcpp::ParameterValue(1.0));
+	nav2_util::declare_parameter_if_not_declared(parent,plugin_name_ + ".mpc_weight_yaw", rclcpp::ParameterValue(0.3));
+	nav2_util::declare_parameter_if_not_declared(parent,plugin_name_ + ".mpc_weight_cost", rclcpp::ParameterValue(5.0));
+	nav2_util::declare_parameter_if_not_declared(parent,plugin_name_ + ".control_cpus", rclcpp::ParameterValue(""));
+	nav2_util::declare_parameter_if_not_declared(parent,plugin_name_ + ".control_priority", rclcpp::ParameterValue(0));
+	nav2_util::declare_parameter_if_not_declared(parent,plugin_name_ + ".worker_cpus", rclcpp::ParameterValue(""));
+	nav2_util::declare_parameter_if_not_declared(parent,plugin_name_ + ".worker_priority", rclcpp::ParameterValue(0));
+	nav2_util::declare_parameter_if_not_declared(parent,plugin_name_ + ".prefault_stack_size", rclcpp::ParameterValue(0));
+	nav2_util::declare_parameter_if_not_declared(parent,plugin_name_ + ".mpc_weight_smooth", rclcpp::ParameterValue(0.1));
+	nav2_util::declare_parameter_if_not_declared(parent,plugin_name_ + ".scan_template_max_curvature", rclcpp::ParameterValue(1.0));
+	nav2_util::declare_parameter_if_not_declared(parent,plugin_name_ + ".scan_template_curvature_bins", rclcpp::ParameterValue(101));
+	nav2_util::declare_parameter_if_not_declared(parent,plugin_name_ + ".scan_template_yaw_bins", rclcpp::ParameterValue(720));
+	nav2_util::declare_parameter_if_not_declared(parent,plugin_name_ + ".scan_template_tolerance", rclcpp::ParameterValue(0.1));
+	nav2_util::declare_parameter_if_not_declared(parent,plugin_name_ + ".odom_topic", rclcpp::ParameterValue(std::string("/odom")));
+	nav2_util::declare_parameter_if_not_declared(parent,plugin_name_ + ".local_plan_topic", rclcpp::ParameterValue(std::string("/local_plan")));
 
 	parent->get_parameter_or(plugin_name_ + ".acc_lim_x", acc_lim_x, 0.5);
 	parent->get_parameter_or(plugin_name_ + ".acc_lim_y", acc_lim_y, 0.5);
@@ -777,6 +1816,67 @@ void NeoLocalPlanner::configure(const rclcpp_lifecycle::LifecycleNode::SharedPtr
 	parent->get_parameter_or(plugin_name_ + ".emergency_acc_lim_x", emergency_acc_lim_x, 0.5);
 	parent->get_parameter_or(plugin_name_ + ".differential_drive", differential_drive, true);
 	parent->get_parameter_or(plugin_name_ + ".constrain_final", constrain_final, false);
+	parent->get_parameter_or(plugin_name_ + ".scan_reuse_tolerance", scan_reuse_tolerance, 0.02);
+	parent->get_parameter_or(plugin_name_ + ".scan_refresh_cycles", scan_refresh_cycles, 10);
+	parent->get_parameter_or(plugin_name_ + ".latency_compensation", latency_compensation, false);
+	parent->get_parameter_or(plugin_name_ + ".actuation_delay", actuation_delay, 0.0);
+	parent->get_parameter_or(plugin_name_ + ".max_latency", max_latency, 0.1);
+	parent->get_parameter_or(plugin_name_ + ".odom_history_size", odom_history_size, 50);
+	parent->get_parameter_or(plugin_name_ + ".plan_dedupe_dist", plan_preprocessing.dedupe_dist, 0.001);
+	parent->get_parameter_or(plugin_name_ + ".plan_simplify_tolerance", plan_preprocessing.simplify_tolerance, 0.0);
+	parent->get_parameter_or(plugin_name_ + ".plan_simplify_max_angle", plan_preprocessing.simplify_max_angle, M_PI / 2);
+	parent->get_parameter_or(plugin_name_ + ".plan_resample_step", plan_preprocessing.resample_step, 0.0);
+	parent->get_parameter_or(plugin_name_ + ".log_throttle_period", log_throttle_period, 1.0);
+	parent->get_parameter_or(plugin_name_ + ".flight_recorder_size", flight_recorder_size, 1000);
+	parent->get_parameter_or(plugin_name_ + ".flight_recorder_file", flight_recorder_file, default_flight_recorder_file);
+	parent->get_parameter_or(plugin_name_ + ".cycle_time_budget", cycle_time_budget, 0.0);
+	parent->get_parameter_or(plugin_name_ + ".parallel_stages", parallel_stages, false);
+	parent->get_parameter_or(plugin_name_ + ".num_stage_threads", num_stage_threads, 0);
+	parent->get_parameter_or(plugin_name_ + ".perception_rate", perception_rate, 0.0);
+	parent->get_parameter_or(plugin_name_ + ".perception_timeout", perception_timeout, 0.5);
+	parent->get_parameter_or(plugin_name_ + ".real_time_mode", real_time_mode, false);
+	parent->get_parameter_or(plugin_name_ + ".scan_templates", scan_templates, false);
+	parent->get_parameter_or(plugin_name_ + ".plan_search_window", plan_search_window, 5.0);
+	parent->get_parameter_or(plugin_name_ + ".plan_splice_tolerance", plan_splice_tolerance, 0.01);
+	parent->get_parameter_or(plugin_name_ + ".plan_splice_yaw_tolerance", plan_splice_yaw_tolerance, 0.01);
+	parent->get_parameter_or(plugin_name_ + ".ego_grid_size", ego_grid_size, 0);
+	parent->get_parameter_or(plugin_name_ + ".speed_map_dist", speed_map_dist, 0.0);
+	parent->get_parameter_or(plugin_name_ + ".speed_map_step", speed_map_step, 0.1);
+	parent->get_parameter_or(plugin_name_ + ".speed_map_refresh_cycles", speed_map_refresh_cycles, 10);
+	parent->get_parameter_or(plugin_name_ + ".mpc_mode", mpc_mode, false);
+	parent->get_parameter_or(plugin_name_ + ".mpc_horizon", mpc_params.horizon, 10);
+	parent->get_parameter_or(plugin_name_ + ".mpc_dt", mpc_params.dt, 0.1);
+	parent->get_parameter_or(plugin_name_ + ".mpc_iterations", mpc_params.max_iterations, 20);
+	parent->get_parameter_or(plugin_name_ + ".mpc_weight_pos", mpc_params.weight_pos, 1.0);
+	parent->get_parameter_or(plugin_name_ + ".mpc_weight_yaw", mpc_params.weight_yaw, 0.3);
+	parent->get_parameter_or(plugin_name_ + ".mpc_weight_cost", mpc_params.weight_cost, 5.0);
+	{
+		std::string control_cpus;
+		std::string worker_cpus;
+		int prefault_stack_size = 0;
+		parent->get_parameter_or(plugin_name_ + ".control_cpus", control_cpus, std::string());
+		parent->get_parameter_or(plugin_name_ + ".control_priority", control_thread.priority, 0);
+		parent->get_parameter_or(plugin_name_ + ".worker_cpus", worker_cpus, std::string());
+		parent->get_parameter_or(plugin_name_ + ".worker_priority", worker_thread.priority, 0);
+		parent->get_parameter_or(plugin_name_ + ".prefault_stack_size", prefault_stack_size, 0);
+
+		std::string error;
+		if(!parse_cpu_list(control_cpus, control_thread.cpus, error)) {
+			RCLCPP_WARN(logger_, "control_cpus: %s, using all CPUs", error.c_str());
+		}
+		if(!parse_cpu_list(worker_cpus, worker_thread.cpus, error)) {
+			RCLCPP_WARN(logger_, "worker_cpus: %s, using all CPUs", error.c_str());
+		}
+		control_thread.prefault_stack = std::max(prefault_stack_size, 0);
+		worker_thread.prefault_stack = std::max(prefault_stack_size, 0);
+	}
+	parent->get_parameter_or(plugin_name_ + ".mpc_weight_smooth", mpc_params.weight_smooth, 0.1);
+	parent->get_parameter_or(plugin_name_ + ".scan_template_max_curvature", scan_template_params.max_curvature, 1.0);
+	parent->get_parameter_or(plugin_name_ + ".scan_template_curvature_bins", scan_template_params.num_curvature_bins, 101);
+	parent->get_parameter_or(plugin_name_ + ".scan_template_yaw_bins", scan_template_params.num_yaw_bins, 720);
+	parent->get_parameter_or(plugin_name_ + ".scan_template_tolerance", scan_template_params.tolerance, 0.1);
+	parent->get_parameter_or(plugin_name_ + ".odom_topic", m_odom_topic, std::string("/odom"));
+	parent->get_parameter_or(plugin_name_ + ".local_plan_topic", m_local_plan_topic, std::string("/local_plan"));
 
 	// Variable manipulation
 	acc_lim_trans = acc_lim_x;
@@ -784,17 +1884,134 @@ void NeoLocalPlanner::configure(const rclcpp_lifecycle::LifecycleNode::SharedPtr
 	trans_stopped_vel = 0.5 * min_vel_trans;
 
 	// Setting up the costmap variables
-	costmap_ros_ = costmap_ros;
-	costmap_ = costmap_ros_->getCostmap();
+	costmap_ros_.reset();
+	costmap_ = costmap;
 	tf_ = tf;
 	plugin_name_ = name;
 	logger_ = parent->get_logger();
+	m_log = std::make_shared<AsyncLogger>(logger_);
 
-	m_base_frame = costmap_ros->getBaseFrameID();
+	m_base_frame = base_frame;
+	m_last_time = clock_->now();
+
+	m_odom_history.resize(std::max(odom_history_size, 1));
+	m_odom_history_next = 0;
+	m_odom_history_count = 0;
 
 	// Creating odometery subscriber and local plan publisher
-	m_odom_sub = parent->create_subscription<nav_msgs::msg::Odometry>("/odom",  rclcpp::SystemDefaultsQoS(), std::bind(&NeoLocalPlanner::odomCallback,this,std::placeholders::_1));
-	m_local_plan_pub = parent->create_publisher<nav_msgs::msg::Path>("/local_plan", 1);
+	m_odom_sub = parent->create_subscription<nav_msgs::msg::Odometry>(m_odom_topic,  rclcpp::SystemDefaultsQoS(), std::bind(&NeoLocalPlanner::odomCallback,this,std::placeholders::_1));
+	m_local_plan_pub = parent->create_publisher<nav_msgs::msg::Path>(m_local_plan_topic, 1);
+	m_degrade_pub = parent->create_publisher<std_msgs::msg::UInt64MultiArray>(plugin_name_ + "/degradation_counts", 1);
+
+	// target search and lookahead only see plan vertices, a simplified plan has to be resampled
+	if(plan_preprocessing.simplify_tolerance > 0 && plan_preprocessing.resample_step <= 0)
+	{
+		plan_preprocessing.resample_step = costmap_->getResolution();
+		RCLCPP_WARN(logger_, "plan_simplify_tolerance is set without plan_resample_step, resampling at the costmap resolution (%f m)",
+					plan_preprocessing.resample_step);
+	}
+
+	// pick control law once, new drive models only need a policy (see differential_drive_t)
+	if(differential_drive) {
+		m_drive_model = getDriveModel<differential_drive_t>();
+	} else {
+		m_drive_model = getDriveModel<holonomic_drive_t>();
+	}
+
+	// MPC uses the same limits as the reactive controller
+	if(mpc_mode)
+	{
+		mpc_params.acc_lim.vx = acc_lim_x;
+		mpc_params.acc_lim.vy = acc_lim_y;
+		mpc_params.acc_lim.yawrate = acc_lim_theta;
+		m_mpc.setParams(mpc_params);
+		m_mpc_reference.resize(m_mpc.getParams().horizon + 1);
+	}
+
+	// precompute obstacle scan arcs
+	if(scan_templates)
+	{
+		scan_template_params.resolution = costmap_->getResolution();
+		scan_template_params.step = max_scan_step;
+		scan_template_params.max_dist = max_scan_dist;
+
+		const auto time_begin = std::chrono::steady_clock::now();
+		m_scan_templates = ScanTemplates::getShared(scan_template_params);
+		m_scan_step_costs.resize(m_scan_templates->getNumSteps());
+
+		RCLCPP_INFO(logger_, "Using %zu scan templates (%.2f m each) after %f sec, %.1f MB shared by all instances",
+					m_scan_templates->getNumTemplates(), (m_scan_templates->getNumSteps() - 1) * max_scan_step,
+					std::chrono::duration<double>(std::chrono::steady_clock::now() - time_begin).count(),
+					m_scan_templates->memoryUsage() / 1e6);
+	}
+
+	// robot centric copy of the costmap, rebuilt every cycle
+	m_ego_grid.configure(ego_grid_size, costmap_->getResolution());
+
+	// speed limits along the plan, published for traffic monitoring
+	{
+		SpeedLimitMap::params_t params;
+		params.step = speed_map_step;
+		params.horizon = speed_map_dist;
+		params.max_vel = max_vel_trans;
+		params.stop_accel = 0.9 * acc_lim_x;
+		params.stop_margin = min_stop_dist;
+		params.max_cost = max_cost;
+		params.refresh_cycles = speed_map_refresh_cycles;
+		m_speed_map.configure(params);
+		m_speed_map.setFootprint(footprint);
+
+		m_speed_map_data.reserve(m_speed_map.getCapacity());
+		m_speed_map_output.clear(std::vector<uint8_t>(m_speed_map.getCapacity()));
+		if(m_speed_map.getCapacity() > 0) {
+			m_speed_map_pub = parent->create_publisher<std_msgs::msg::UInt8MultiArray>(plugin_name_ + "/speed_limit_map", 1);
+		}
+	}
+
+	// preallocate everything the control loop touches
+	if(real_time_mode)
+	{
+		const size_t max_scan_samples = size_t(max_scan_dist / max_scan_step) + 2;
+		m_scan_samples.reserve(max_scan_samples);
+		m_scan_buffer.reserve(max_scan_samples);
+		m_perception.samples.reserve(max_scan_samples);
+		m_local_plan.samples.reserve(max_scan_samples);
+		{
+			local_plan_t initial;
+			initial.samples.resize(max_scan_samples);
+			m_local_plan_output.clear(initial);
+		}
+		if(::mlockall(MCL_CURRENT | MCL_FUTURE) != 0) {
+			RCLCPP_WARN(logger_, "mlockall() failed: %s", strerror(errno));
+		}
+		if(parallel_stages) {
+			RCLCPP_WARN(logger_, "parallel_stages allocates in the control loop, not recommended with real_time_mode");
+		}
+	}
+
+	// persistent pool for intra-cycle fan-out, shared with other planner instances
+	if(parallel_stages)
+	{
+		std::string error;
+		m_stage_pool = WorkerPool::getShared(num_stage_threads, worker_thread, error);
+		if(!error.empty()) {
+			RCLCPP_WARN(logger_, "Using existing stage pool: %s", error.c_str());
+		}
+		if(!m_stage_pool->getConfigError().empty()) {
+			RCLCPP_WARN(logger_, "Stage pool thread placement failed: %s", m_stage_pool->getConfigError().c_str());
+		}
+	}
+
+	// flight recorder, dumped on request, when getting stuck or on emergency braking
+	if(flight_recorder_size > 0)
+	{
+		m_flight_recorder = std::make_shared<FlightRecorder>(flight_recorder_size, flight_recorder_file);
+		if(!m_flight_recorder->isMapped()) {
+			RCLCPP_WARN(logger_, "Failed to map flight recorder file %s", flight_recorder_file.c_str());
+		}
+		m_dump_service = parent->create_service<std_srvs::srv::Trigger>(plugin_name_ + "/dump_flight_record",
+				std::bind(&NeoLocalPlanner::dumpServiceCallback, this, std::placeholders::_1, std::placeholders::_2));
+	}
 
 }
 
@@ -802,6 +2019,69 @@ void NeoLocalPlanner::odomCallback(const nav_msgs::msg::Odometry::SharedPtr msg)
 {
 	boost::mutex::scoped_lock lock(m_odometry_mutex);
 	m_odometry = msg;
+
+	odom_sample_t sample;
+	sample.stamp = rclcpp::Time(msg->header.stamp);
+	sample.x = msg->pose.pose.position.x;
+	sample.y = msg->pose.pose.position.y;
+	sample.yaw = tf2::getYaw(msg->pose.pose.orientation);
+
+	{
+		odom_state_t state;
+		state.x = sample.x;
+		state.y = sample.y;
+		state.yaw = sample.yaw;
+		m_odom_state.write(state);
+	}
+
+	if(m_odom_history.empty()) {
+		return;
+	}
+	if(m_odom_history_count > 0)
+	{
+		const rclcpp::Time& last_stamp = getOdometrySample(m_odom_history_count - 1).stamp;
+		if(sample.stamp == last_stamp) {
+			return;
+		}
+		if(sample.stamp < last_stamp) {
+			m_odom_history_count = 0;		// time jumped back
+		}
+	}
+	m_odom_history[m_odom_history_next] = sample;
+	m_odom_history_next = (m_odom_history_next + 1) % m_odom_history.size();
+	m_odom_history_count = std::min(m_odom_history_count + 1, m_odom_history.size());
+}
+
+const NeoLocalPlanner::odom_sample_t& NeoLocalPlanner::getOdometrySample(size_t i) const
+{
+	const size_t size = m_odom_history.size();
+	return m_odom_history[(m_odom_history_next + size - m_odom_history_count + i) % size];
+}
+
+bool NeoLocalPlanner::interpolateOdometry(const rclcpp::Time& time, odom_sample_t& sample) const
+{
+	if(m_odom_history_count == 0
+		|| time < getOdometrySample(0).stamp
+		|| time > getOdometrySample(m_odom_history_count - 1).stamp)
+	{
+		return false;
+	}
+	for(size_t i = 1; i < m_odom_history_count; ++i)
+	{
+		const odom_sample_t& next = getOdometrySample(i);
+		if(next.stamp < time) {
+			continue;
+		}
+		const odom_sample_t& prev = getOdometrySample(i - 1);
+		const double alpha = (time - prev.stamp).seconds() / (next.stamp - prev.stamp).seconds();
+		sample.stamp = time;
+		sample.x = prev.x + (next.x - prev.x) * alpha;
+		sample.y = prev.y + (next.y - prev.y) * alpha;
+		sample.yaw = prev.yaw + angles::shortest_angular_distance(prev.yaw, next.yaw) * alpha;
+		return true;
+	}
+	sample = getOdometrySample(0);		// only one sample, exactly at time
+	return true;
 }
 
 }
@@ -0,0 +1,100 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2016, Neobotix GmbH
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Neobotix nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+#include "../include/PeriodicTask.h"
+
+#include <algorithm>
+
+
+namespace neo_local_planner {
+
+PeriodicTask::~PeriodicTask()
+{
+	stop();
+}
+
+void PeriodicTask::start(double period, std::function<void()> func)
+{
+	std::string error;
+	start(period, std::move(func), thread_config_t(), error);
+}
+
+bool PeriodicTask::start(double period, std::function<void()> func, const thread_config_t& config, std::string& error)
+{
+	stop();
+
+	m_func = std::move(func);
+	m_do_run = true;
+	m_thread = std::thread(&PeriodicTask::run, this,
+			std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(period)),
+			config.prefault_stack);
+
+	return apply_thread_config(m_thread.native_handle(), config, error);
+}
+
+void PeriodicTask::stop()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_do_run = false;
+	}
+	m_condition.notify_all();
+
+	if(m_thread.joinable()) {
+		m_thread.join();
+	}
+}
+
+void PeriodicTask::run(std::chrono::steady_clock::duration period, size_t prefault_stack_size)
+{
+	prefault_stack(prefault_stack_size);
+
+	auto next_time = std::chrono::steady_clock::now();
+
+	std::unique_lock<std::mutex> lock(m_mutex);
+	while(true)
+	{
+		// don't try to catch up when we fell behind
+		next_time = std::max(next_time + period, std::chrono::steady_clock::now());
+		if(m_condition.wait_until(lock, next_time, [this]() { return !m_do_run; })) {
+			break;
+		}
+		lock.unlock();
+		m_func();
+		lock.lock();
+	}
+}
+
+
+} // neo_local_planner
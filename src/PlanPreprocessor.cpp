@@ -0,0 +1,201 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2016, Neobotix GmbH
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Neobotix nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+#include "../include/PlanPreprocessor.h"
+
+#include <angles/angles.h>
+
+#include <chrono>
+#include <cmath>
+
+
+namespace neo_local_planner {
+
+std::vector<plan_point_t> dedupe_plan(const std::vector<plan_point_t>& plan, double min_dist)
+{
+	std::vector<plan_point_t> out;
+	out.reserve(plan.size());
+
+	for(size_t i = 0; i < plan.size(); ++i)
+	{
+		if(out.empty() || i + 1 == plan.size()
+			|| ::hypot(plan[i].x - out.back().x, plan[i].y - out.back().y) >= min_dist)
+		{
+			out.push_back(plan[i]);
+		}
+	}
+	// replace last kept pose if final one is a duplicate of it
+	if(out.size() >= 2 && ::hypot(out.back().x - out[out.size() - 2].x, out.back().y - out[out.size() - 2].y) < min_dist)
+	{
+		out.erase(out.end() - 2);
+	}
+	return out;
+}
+
+static double segment_heading(const plan_point_t& a, const plan_point_t& b)
+{
+	return ::atan2(b.y - a.y, b.x - a.x);
+}
+
+std::vector<plan_point_t> simplify_plan(const std::vector<plan_point_t>& plan, double tolerance, double max_angle)
+{
+	if(plan.size() <= 2) {
+		return plan;
+	}
+	std::vector<bool> keep(plan.size(), false);
+	keep.front() = true;
+	keep.back() = true;
+
+	// explicit stack instead of recursion, plans can be very long
+	std::vector<std::pair<size_t, size_t>> stack;
+	stack.emplace_back(0, plan.size() - 1);
+
+	while(!stack.empty())
+	{
+		const size_t first = stack.back().first;
+		const size_t last = stack.back().second;
+		stack.pop_back();
+
+		if(last - first < 2) {
+			continue;
+		}
+		const double dx = plan[last].x - plan[first].x;
+		const double dy = plan[last].y - plan[first].y;
+		const double length = ::hypot(dx, dy);
+
+		size_t split = first;
+		double max_dist = 0;
+		double net_turn = 0;
+		for(size_t i = first + 1; i < last; ++i)
+		{
+			double dist = 0;
+			if(length > 0) {
+				dist = fabs(dx * (plan[i].y - plan[first].y) - dy * (plan[i].x - plan[first].x)) / length;
+			} else {
+				dist = ::hypot(plan[i].x - plan[first].x, plan[i].y - plan[first].y);
+			}
+			if(dist > max_dist) {
+				max_dist = dist;
+				split = i;
+			}
+			net_turn += angles::shortest_angular_distance(segment_heading(plan[i - 1], plan[i]),
+															segment_heading(plan[i], plan[i + 1]));
+		}
+
+		if(max_dist > tolerance || (max_angle > 0 && fabs(net_turn) > max_angle))
+		{
+			if(split == first) {
+				split = (first + last) / 2;
+			}
+			keep[split] = true;
+			stack.emplace_back(first, split);
+			stack.emplace_back(split, last);
+		}
+	}
+
+	std::vector<plan_point_t> out;
+	for(size_t i = 0; i < plan.size(); ++i) {
+		if(keep[i]) {
+			out.push_back(plan[i]);
+		}
+	}
+	return out;
+}
+
+std::vector<plan_point_t> resample_plan(const std::vector<plan_point_t>& plan, double step)
+{
+	if(plan.size() <= 1 || step <= 0) {
+		return plan;
+	}
+	std::vector<plan_point_t> out;
+	out.push_back(plan.front());
+
+	double offset = step;		// distance along current segment of next output point
+	for(size_t i = 0; i + 1 < plan.size(); ++i)
+	{
+		const plan_point_t& a = plan[i];
+		const plan_point_t& b = plan[i + 1];
+		const double length = ::hypot(b.x - a.x, b.y - a.y);
+		const double delta_yaw = angles::shortest_angular_distance(a.yaw, b.yaw);
+
+		while(offset < length)
+		{
+			const double alpha = offset / length;
+			plan_point_t point;
+			point.x = a.x + (b.x - a.x) * alpha;
+			point.y = a.y + (b.y - a.y) * alpha;
+			point.yaw = angles::normalize_angle(a.yaw + delta_yaw * alpha);
+			out.push_back(point);
+			offset += step;
+		}
+		offset -= length;
+	}
+
+	// final pose replaces last sample if that is too close
+	if(out.size() >= 2 && ::hypot(plan.back().x - out.back().x, plan.back().y - out.back().y) < 0.5 * step) {
+		out.back() = plan.back();
+	} else {
+		out.push_back(plan.back());
+	}
+	return out;
+}
+
+std::vector<plan_point_t> preprocess_plan(	std::vector<plan_point_t> plan,
+											const preprocess_params_t& params,
+											preprocess_stats_t* stats)
+{
+	const auto time_begin = std::chrono::steady_clock::now();
+	const size_t num_input = plan.size();
+
+	std::vector<plan_point_t> out = std::move(plan);
+	if(params.dedupe_dist > 0) {
+		out = dedupe_plan(out, params.dedupe_dist);
+	}
+	if(params.simplify_tolerance > 0) {
+		out = simplify_plan(out, params.simplify_tolerance, params.simplify_max_angle);
+	}
+	if(params.resample_step > 0) {
+		out = resample_plan(out, params.resample_step);
+	}
+
+	if(stats) {
+		stats->num_input = num_input;
+		stats->num_output = out.size();
+		stats->runtime = std::chrono::duration<double>(std::chrono::steady_clock::now() - time_begin).count();
+	}
+	return out;
+}
+
+
+} // neo_local_planner
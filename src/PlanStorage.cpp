@@ -0,0 +1,232 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2016, Neobotix GmbH
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Neobotix nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+#include "../include/PlanStorage.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+
+namespace neo_local_planner {
+
+void PlanStorage::assign(const std::vector<plan_point_t>& points)
+{
+	const size_t count = points.size();
+	x.resize(count);
+	y.resize(count);
+	yaw.resize(count);
+	s.resize(count);
+
+	for(size_t i = 0; i < count; ++i)
+	{
+		x[i] = points[i].x;
+		y[i] = points[i].y;
+		yaw[i] = points[i].yaw;
+		s[i] = i > 0 ? s[i - 1] + ::hypot(x[i] - x[i - 1], y[i] - y[i - 1]) : 0;
+	}
+}
+
+/*
+ * Rearranges v into [old prefix][middle][old suffix], writes the middle via get(i).
+ */
+template<typename T, typename F>
+static void splice_array(std::vector<T>& v, const PlanStorage::splice_t& splice, size_t new_size, F get)
+{
+	const size_t old_suffix = v.size() - splice.suffix;
+	const size_t new_suffix = new_size - splice.suffix;
+
+	std::move(v.begin() + splice.offset, v.begin() + splice.offset + splice.prefix, v.begin());
+	if(new_suffix <= old_suffix) {
+		std::move(v.begin() + old_suffix, v.end(), v.begin() + new_suffix);
+		v.resize(new_size);
+	} else {
+		v.resize(new_size);
+		std::move_backward(v.begin() + old_suffix, v.begin() + old_suffix + splice.suffix, v.end());
+	}
+	for(size_t i = splice.prefix; i < new_suffix; ++i) {
+		v[i] = get(i);
+	}
+}
+
+bool PlanStorage::splice(	const std::vector<plan_point_t>& points, double tolerance, double yaw_tolerance,
+							size_t hint, double search_dist, splice_t* result)
+{
+	splice_t splice;
+	splice.old_size = size();
+
+	const auto is_match = [this, &points, tolerance, yaw_tolerance](size_t old_index, size_t new_index) -> bool
+	{
+		const plan_point_t& point = points[new_index];
+		return ::hypot(x[old_index] - point.x, y[old_index] - point.y) <= tolerance
+			&& fabs(::remainder(yaw[old_index] - point.yaw, 2 * M_PI)) <= yaw_tolerance;
+	};
+
+	if(!empty() && !points.empty())
+	{
+		// new plan usually starts where the robot is now, somewhere along the old one
+		double dist = 0;
+		splice.offset = search_dist > 0 ?
+				findClosestInWindow(points[0].x, points[0].y, hint, 0.2 * search_dist, search_dist, &dist) :
+				findClosest(points[0].x, points[0].y, 0, size(), &dist);
+		if(dist <= tolerance)
+		{
+			while(splice.offset + splice.prefix < size() && splice.prefix < points.size()
+				&& is_match(splice.offset + splice.prefix, splice.prefix))
+			{
+				splice.prefix++;
+			}
+		}
+		else {
+			splice.offset = 0;
+		}
+		while(splice.offset + splice.prefix + splice.suffix < size() && splice.prefix + splice.suffix < points.size()
+			&& is_match(size() - 1 - splice.suffix, points.size() - 1 - splice.suffix))
+		{
+			splice.suffix++;
+		}
+	}
+	if(result) {
+		*result = splice;
+	}
+	if(splice.prefix + splice.suffix == 0)
+	{
+		assign(points);
+		return false;
+	}
+
+	const size_t new_size = points.size();
+	const size_t new_suffix = new_size - splice.suffix;
+	const double prefix_base = s[splice.offset];
+
+	splice_array(x, splice, new_size, [&points](size_t i) { return points[i].x; });
+	splice_array(y, splice, new_size, [&points](size_t i) { return points[i].y; });
+	splice_array(yaw, splice, new_size, [&points](size_t i) { return points[i].yaw; });
+	splice_array(s, splice, new_size, [](size_t) { return 0.; });
+
+	// arc lengths: shift the kept parts, integrate only the middle
+	for(size_t i = 0; i < splice.prefix; ++i) {
+		s[i] -= prefix_base;
+	}
+	for(size_t i = splice.prefix; i < new_suffix; ++i) {
+		s[i] = i > 0 ? s[i - 1] + ::hypot(x[i] - x[i - 1], y[i] - y[i - 1]) : 0;
+	}
+	if(splice.suffix > 0)
+	{
+		const double suffix_begin = new_suffix > 0 ?
+				s[new_suffix - 1] + ::hypot(x[new_suffix] - x[new_suffix - 1], y[new_suffix] - y[new_suffix - 1]) : 0;
+		const double delta = suffix_begin - s[new_suffix];
+		for(size_t i = new_suffix; i < new_size; ++i) {
+			s[i] += delta;
+		}
+	}
+	return true;
+}
+
+size_t PlanStorage::mapIndex(const splice_t& splice, size_t new_size, size_t old_index, size_t fallback)
+{
+	if(old_index >= splice.offset && old_index < splice.offset + splice.prefix) {
+		return old_index - splice.offset;
+	}
+	if(old_index >= splice.old_size - splice.suffix && old_index < splice.old_size) {
+		return old_index - (splice.old_size - splice.suffix) + new_size - splice.suffix;
+	}
+	return fallback;
+}
+
+void PlanStorage::clear()
+{
+	x.clear();
+	y.clear();
+	yaw.clear();
+	s.clear();
+}
+
+size_t PlanStorage::findClosest(double px, double py, size_t begin, size_t end, double* actual_dist) const
+{
+	size_t index = begin;
+	double dist_short = std::numeric_limits<double>::infinity();
+
+	for(size_t i = begin; i < end; ++i)
+	{
+		const double dx = x[i] - px;
+		const double dy = y[i] - py;
+		const double dist = dx * dx + dy * dy;
+		if(dist < dist_short)
+		{
+			dist_short = dist;
+			index = i;
+		}
+	}
+	if(actual_dist) {
+		*actual_dist = ::sqrt(dist_short);
+	}
+	return index;
+}
+
+size_t PlanStorage::findClosestInWindow(	double px, double py, size_t center, double dist_back, double dist_ahead,
+											double* actual_dist) const
+{
+	if(center >= s.size()) {
+		return findClosest(px, py, 0, s.size(), actual_dist);
+	}
+	const size_t begin = std::lower_bound(s.begin(), s.begin() + center, s[center] - dist_back) - s.begin();
+	const size_t end = std::upper_bound(s.begin() + center, s.end(), s[center] + dist_ahead) - s.begin();
+	return findClosest(px, py, begin, end, actual_dist);
+}
+
+size_t PlanStorage::moveAlong(size_t begin, double dist, double* actual_dist) const
+{
+	if(begin >= s.size()) {
+		if(actual_dist) {
+			*actual_dist = 0;
+		}
+		return begin;
+	}
+	const auto iter = std::lower_bound(s.begin() + begin, s.end(), s[begin] + dist);
+	const size_t index = iter != s.end() ? size_t(iter - s.begin()) : s.size() - 1;
+
+	if(actual_dist) {
+		*actual_dist = s[index] - s[begin];
+	}
+	return index;
+}
+
+size_t PlanStorage::memoryUsage() const
+{
+	return (x.capacity() + y.capacity() + yaw.capacity() + s.capacity()) * sizeof(double);
+}
+
+
+} // neo_local_planner
@@ -0,0 +1,225 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2016, Neobotix GmbH
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Neobotix nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+#include "../include/ScanTemplates.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <map>
+#include <mutex>
+#include <tuple>
+
+
+namespace neo_local_planner {
+
+void ScanTemplates::build(const params_t& params)
+{
+	clear();
+	m_params = params;
+	m_params.num_curvature_bins = std::max(m_params.num_curvature_bins, 1);
+	m_params.num_yaw_bins = std::max((m_params.num_yaw_bins + 3) / 4 * 4, 4);
+	m_yaw_bins_per_quadrant = m_params.num_yaw_bins / 4;
+
+	if(m_params.resolution <= 0 || m_params.step <= 0) {
+		return;
+	}
+
+	// length until lateral error (half_dyaw * s + half_dk * s^2 / 2) exceeds tolerance
+	const double half_dyaw = M_PI / m_params.num_yaw_bins;
+	const double half_dk = m_params.num_curvature_bins > 1 ?
+			0.5 * m_params.max_curvature / (m_params.num_curvature_bins - 1) : 0;
+	double length = m_params.max_dist;
+	if(half_dk > 0) {
+		length = fmin((sqrt(half_dyaw * half_dyaw + 2 * half_dk * m_params.tolerance) - half_dyaw) / half_dk, length);
+	} else {
+		length = fmin(m_params.tolerance / half_dyaw, length);
+	}
+	m_num_steps = int(length / m_params.step) + 1;
+
+	m_offsets.resize(size_t(m_params.num_curvature_bins) * m_yaw_bins_per_quadrant * m_num_steps);
+
+	offset_t* out = m_offsets.data();
+	for(int k = 0; k < m_params.num_curvature_bins; ++k)
+	{
+		const double curvature = k * 2 * half_dk;
+
+		for(int j = 0; j < m_yaw_bins_per_quadrant; ++j)
+		{
+			// same integration as NeoLocalPlanner::scanObstacles()
+			double x = 0;
+			double y = 0;
+			double yaw = j * 2 * half_dyaw;
+
+			for(int i = 0; i < m_num_steps; ++i)
+			{
+				out->dx = int16_t(::floor(x / m_params.resolution + 0.5));
+				out->dy = int16_t(::floor(y / m_params.resolution + 0.5));
+				out++;
+
+				x += m_params.step * cos(yaw);
+				y += m_params.step * sin(yaw);
+				yaw += curvature * m_params.step;
+			}
+		}
+	}
+}
+
+void ScanTemplates::clear()
+{
+	m_offsets.clear();
+	m_offsets.shrink_to_fit();
+	m_num_steps = 0;
+}
+
+size_t ScanTemplates::memoryUsage() const
+{
+	return m_offsets.capacity() * sizeof(offset_t);
+}
+
+bool ScanTemplates::scan(	const unsigned char* costs, int size_x, int size_y, int mx, int my,
+							double yaw, double curvature, int num_steps, int stop_cost,
+							unsigned char* step_costs, scan_result_t& result) const
+{
+	result = scan_result_t();
+
+	if(empty()) {
+		return false;
+	}
+	const double bin_dk = m_params.num_curvature_bins > 1 ?
+			m_params.max_curvature / (m_params.num_curvature_bins - 1) : 0;
+	const int curvature_bin = bin_dk > 0 ? int(::floor(fabs(curvature) / bin_dk + 0.5)) : 0;
+	if(curvature_bin >= m_params.num_curvature_bins || (bin_dk == 0 && curvature != 0)) {
+		return false;
+	}
+
+	// negative curvature is the mirror image (y -> -y) of positive curvature at -yaw
+	const bool mirror = curvature < 0;
+	const double bin_dyaw = 2 * M_PI / m_params.num_yaw_bins;
+	int yaw_bin = int(::floor((mirror ? -yaw : yaw) / bin_dyaw + 0.5)) % m_params.num_yaw_bins;
+	if(yaw_bin < 0) {
+		yaw_bin += m_params.num_yaw_bins;
+	}
+	const int quadrant = yaw_bin / m_yaw_bins_per_quadrant;
+
+	const offset_t* offsets = m_offsets.data()
+			+ (size_t(curvature_bin) * m_yaw_bins_per_quadrant + yaw_bin % m_yaw_bins_per_quadrant) * m_num_steps;
+
+	num_steps = std::min(num_steps, m_num_steps);
+
+	int last_x = mx;
+	int last_y = my;
+	for(int i = 0; i < num_steps; ++i)
+	{
+		// rotate by quadrant * 90 degrees, then mirror
+		int dx = offsets[i].dx;
+		int dy = offsets[i].dy;
+		switch(quadrant) {
+			case 1: std::swap(dx, dy); dx = -dx; break;
+			case 2: dx = -dx; dy = -dy; break;
+			case 3: std::swap(dx, dy); dy = -dy; break;
+		}
+		if(mirror) {
+			dy = -dy;
+		}
+		const int x = mx + dx;
+		const int y = my + dy;
+
+		result.num_steps = i + 1;
+
+		if(x < 0 || y < 0 || x >= size_x || y >= size_y) {
+			step_costs[i] = 0;
+			result.left_map = true;
+			break;
+		}
+		int cost = costs[size_t(y) * size_x + x];
+
+		// cells in between, only if step is larger than a cell
+		const int adx = std::abs(x - last_x);
+		const int ady = std::abs(y - last_y);
+		if(adx > 1 || ady > 1)
+		{
+			const int n = std::max(adx, ady);
+			for(int k = 1; k < n; ++k) {
+				const int cx = last_x + ((x - last_x) * k * 2 + (x > last_x ? n : -n)) / (2 * n);
+				const int cy = last_y + ((y - last_y) * k * 2 + (y > last_y ? n : -n)) / (2 * n);
+				cost = std::max(cost, int(costs[size_t(cy) * size_x + cx]));
+			}
+		}
+		step_costs[i] = (unsigned char)cost;
+		last_x = x;
+		last_y = y;
+
+		if(cost >= stop_cost) {
+			result.have_obstacle = true;
+			break;
+		}
+	}
+	return true;
+}
+
+std::shared_ptr<const ScanTemplates> ScanTemplates::getShared(const params_t& params)
+{
+	typedef std::tuple<double, double, double, double, int, int, double> key_t;
+
+	static std::mutex mutex;
+	static std::map<key_t, std::weak_ptr<const ScanTemplates>> instances;
+
+	const key_t key(params.resolution, params.step, params.max_dist, params.max_curvature,
+					params.num_curvature_bins, params.num_yaw_bins, params.tolerance);
+
+	// others asking for the same table wait for it to be built
+	std::lock_guard<std::mutex> lock(mutex);
+	auto table = instances[key].lock();
+	if(!table)
+	{
+		auto new_table = std::make_shared<ScanTemplates>();
+		new_table->build(params);
+		table = new_table;
+		instances[key] = table;
+	}
+
+	// forget tables nobody uses anymore
+	for(auto iter = instances.begin(); iter != instances.end();) {
+		if(iter->second.expired()) {
+			iter = instances.erase(iter);
+		} else {
+			++iter;
+		}
+	}
+	return table;
+}
+
+
+} // neo_local_planner
@@ -0,0 +1,268 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2016, Neobotix GmbH
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Neobotix nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+#include "../include/SpeedLimitMap.h"
+
+#include "nav2_util/line_iterator.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+
+namespace neo_local_planner {
+
+void SpeedLimitMap::configure(const params_t& params)
+{
+	clear();
+	if(params.horizon <= 0 || params.step <= 0) {
+		return;
+	}
+	m_params = params;
+
+	const size_t capacity = size_t(std::ceil(params.horizon / params.step)) + 2;
+	m_x.resize(capacity);
+	m_y.resize(capacity);
+	m_yaw.resize(capacity);
+	m_map_x.resize(capacity);
+	m_map_y.resize(capacity);
+	m_cost.resize(capacity);
+	m_speed.resize(capacity);
+}
+
+void SpeedLimitMap::clear()
+{
+	m_params = params_t();
+	m_is_valid = false;
+	m_num_stations = 0;
+	m_x.clear();
+	m_y.clear();
+	m_yaw.clear();
+	m_map_x.clear();
+	m_map_y.clear();
+	m_cost.clear();
+	m_speed.clear();
+}
+
+void SpeedLimitMap::setFootprint(const nav2_costmap_2d::Footprint& footprint)
+{
+	m_footprint_x.clear();
+	m_footprint_y.clear();
+	m_footprint_radius = 0;
+	for(const auto& point : footprint) {
+		m_footprint_x.push_back(point.x);
+		m_footprint_y.push_back(point.y);
+		m_footprint_radius = std::max(m_footprint_radius, ::hypot(point.x, point.y));
+	}
+	m_footprint_cell_x.resize(footprint.size());
+	m_footprint_cell_y.resize(footprint.size());
+	m_is_valid = false;
+}
+
+void SpeedLimitMap::computeStationPose(const PlanStorage& plan, double s, size_t& index, size_t i)
+{
+	// index is the segment start, only moves forward as stations are ascending
+	while(index + 1 < plan.size() && plan.s[index + 1] <= s) {
+		index++;
+	}
+	if(index + 1 < plan.size() && plan.s[index + 1] > plan.s[index])
+	{
+		const double dx = plan.x[index + 1] - plan.x[index];
+		const double dy = plan.y[index + 1] - plan.y[index];
+		const double t = std::min(std::max((s - plan.s[index]) / (plan.s[index + 1] - plan.s[index]), 0.), 1.);
+		m_x[i] = plan.x[index] + t * dx;
+		m_y[i] = plan.y[index] + t * dy;
+		m_yaw[i] = ::atan2(dy, dx);
+	}
+	else
+	{
+		m_x[i] = plan.x[index];
+		m_y[i] = plan.y[index];
+		m_yaw[i] = plan.yaw[index];
+	}
+}
+
+double SpeedLimitMap::computeFootprintCost(nav2_costmap_2d::Costmap2D* costmap, double x, double y, double yaw)
+{
+	if(m_footprint_x.empty())
+	{
+		unsigned int cell[2] = {};
+		if(!costmap->worldToMap(x, y, cell[0], cell[1])) {
+			return nav2_costmap_2d::LETHAL_OBSTACLE / 255.;
+		}
+		return costmap->getCost(cell[0], cell[1]) / 255.;
+	}
+
+	// corners to cells, a corner off the map counts as lethal (same rounding as nav2)
+	const double cos_yaw = ::cos(yaw);
+	const double sin_yaw = ::sin(yaw);
+	const size_t num_corners = m_footprint_x.size();
+	for(size_t k = 0; k < num_corners; ++k)
+	{
+		const double corner_x = x + (m_footprint_x[k] * cos_yaw - m_footprint_y[k] * sin_yaw);
+		const double corner_y = y + (m_footprint_x[k] * sin_yaw + m_footprint_y[k] * cos_yaw);
+		if(!costmap->worldToMap(corner_x, corner_y, m_footprint_cell_x[k], m_footprint_cell_y[k])) {
+			return nav2_costmap_2d::LETHAL_OBSTACLE / 255.;
+		}
+	}
+
+	// max cost along the closed outline, an edge ends at its first lethal cell like in nav2,
+	// which also draws the closing edge from the first to the last corner
+	unsigned char max_cost = 0;
+	for(size_t k = 0; k < num_corners; ++k)
+	{
+		const size_t begin = k + 1 < num_corners ? k : 0;
+		const size_t end = k + 1 < num_corners ? k + 1 : k;
+		unsigned char edge_cost = 0;
+		for(nav2_util::LineIterator line(m_footprint_cell_x[begin], m_footprint_cell_y[begin], m_footprint_cell_x[end], m_footprint_cell_y[end]);
+			line.isValid(); line.advance())
+		{
+			const unsigned char cost = costmap->getCost(line.getX(), line.getY());
+			if(cost == nav2_costmap_2d::LETHAL_OBSTACLE) {
+				edge_cost = cost;
+				break;
+			}
+			edge_cost = std::max(edge_cost, cost);
+		}
+		max_cost = std::max(max_cost, edge_cost);
+		if(max_cost == nav2_costmap_2d::LETHAL_OBSTACLE) {
+			break;
+		}
+	}
+	return max_cost / 255.;
+}
+
+void SpeedLimitMap::update(	const PlanStorage& plan, size_t progress, const SE2& plan_to_map,
+							nav2_costmap_2d::Costmap2D* costmap, const double dirty_bounds[4])
+{
+	if(m_speed.empty() || plan.empty()) {
+		m_is_valid = false;
+		return;
+	}
+	const double step = m_params.step;
+	const double s_begin = plan.s[std::min(progress, plan.size() - 1)];
+	const int64_t first_station = int64_t(std::floor(s_begin / step));
+	const int64_t last_station = std::min(	int64_t(std::floor((s_begin + m_params.horizon) / step)),
+											int64_t(std::floor(plan.s.back() / step)));
+	const size_t num_stations = std::min(size_t(std::max(last_station - first_station + 1, int64_t(1))), m_speed.size());
+
+	// check everything again if the plan moved in the costmap, or once in a while
+	bool is_full_refresh = !m_is_valid || ++m_age >= m_params.refresh_cycles;
+	if(!is_full_refresh)
+	{
+		const SE2 delta = m_plan_to_map.inverse() * plan_to_map;
+		const double max_shift = ::hypot(delta.x(), delta.y()) + std::fabs(delta.yaw()) * m_params.horizon;
+		is_full_refresh = max_shift > 0.5 * costmap->getResolution();
+	}
+	if(is_full_refresh) {
+		m_age = 0;
+	}
+
+	// keep stations still inside the window
+	size_t num_kept = 0;
+	if(!is_full_refresh && first_station >= m_first_station && first_station < m_first_station + int64_t(m_num_stations))
+	{
+		const size_t shift = size_t(first_station - m_first_station);
+		num_kept = std::min(m_num_stations - shift, num_stations);
+		for(auto* array : {&m_x, &m_y, &m_yaw, &m_map_x, &m_map_y, &m_cost}) {
+			std::copy(array->begin() + shift, array->begin() + shift + num_kept, array->begin());
+		}
+	}
+
+	// place new stations on the plan
+	if(num_kept < num_stations)
+	{
+		const double s_new = (first_station + int64_t(num_kept)) * step;
+		size_t index = std::upper_bound(plan.s.begin(), plan.s.end(), s_new) - plan.s.begin();
+		index = index > 0 ? index - 1 : 0;
+		for(size_t i = num_kept; i < num_stations; ++i) {
+			computeStationPose(plan, (first_station + int64_t(i)) * step, index, i);
+		}
+	}
+	plan_to_map.transform(m_x.data(), m_y.data(), m_map_x.data(), m_map_y.data(), num_stations);
+
+	// footprint checks for new stations and those the last costmap update could have reached
+	const double margin = m_footprint_radius + costmap->getResolution();
+	for(size_t i = 0; i < num_stations; ++i)
+	{
+		const bool is_dirty = m_map_x[i] + margin >= dirty_bounds[0] && m_map_x[i] - margin <= dirty_bounds[2]
+							&& m_map_y[i] + margin >= dirty_bounds[1] && m_map_y[i] - margin <= dirty_bounds[3];
+		if(i >= num_kept || is_dirty) {
+			m_cost[i] = computeFootprintCost(costmap, m_map_x[i], m_map_y[i], m_yaw[i] + plan_to_map.yaw());
+		}
+	}
+
+	// backward pass, distance to next blocked station gives the stopping limit
+	const double block_cost = m_footprint_x.empty() ? m_params.max_cost : nav2_costmap_2d::LETHAL_OBSTACLE / 255.;
+	double block_dist = std::numeric_limits<double>::infinity();
+	for(size_t i = num_stations; i-- > 0;)
+	{
+		if(m_cost[i] >= block_cost) {
+			block_dist = 0;
+		} else if(i + 1 < num_stations) {
+			block_dist += step;
+		}
+		const double stop_dist = std::max(block_dist - m_params.stop_margin, 0.);
+		m_speed[i] = std::min(m_params.max_vel, std::sqrt(2 * m_params.stop_accel * stop_dist));
+	}
+
+	m_plan_to_map = plan_to_map;
+	m_first_station = first_station;
+	m_num_stations = num_stations;
+	m_is_valid = true;
+}
+
+double SpeedLimitMap::getSpeedLimit(const PlanStorage& plan, size_t index) const
+{
+	if(!m_is_valid || index >= plan.size()) {
+		return m_params.max_vel;
+	}
+	const int64_t offset = int64_t(std::floor(plan.s[index] / m_params.step)) - m_first_station;
+	if(offset < 0 || offset >= int64_t(m_num_stations)) {
+		return m_params.max_vel;
+	}
+	return m_speed[offset];
+}
+
+void SpeedLimitMap::encode(std::vector<uint8_t>& data, double resolution) const
+{
+	const size_t num_stations = getNumStations();
+	data.resize(num_stations);
+	for(size_t i = 0; i < num_stations; ++i) {
+		data[i] = uint8_t(std::min(std::round(m_speed[i] / resolution), 255.));
+	}
+}
+
+
+} // neo_local_planner
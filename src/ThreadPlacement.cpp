@@ -0,0 +1,202 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2016, Neobotix GmbH
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Neobotix nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+#include "../include/ThreadPlacement.h"
+
+#include <algorithm>
+#include <alloca.h>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+
+namespace neo_local_planner {
+
+bool parse_cpu_list(const std::string& list, std::vector<int>& cpus, std::string& error)
+{
+	std::vector<int> result;
+	const long num_cpus = ::sysconf(_SC_NPROCESSORS_CONF);
+
+	size_t pos = 0;
+	while(pos < list.size())
+	{
+		size_t end = list.find(',', pos);
+		if(end == std::string::npos) {
+			end = list.size();
+		}
+		const std::string item = list.substr(pos, end - pos);
+		pos = end + 1;
+
+		if(item.empty()) {
+			continue;
+		}
+		char* item_end = 0;
+		const long first = ::strtol(item.c_str(), &item_end, 10);
+		long last = first;
+		if(*item_end == '-') {
+			last = ::strtol(item_end + 1, &item_end, 10);
+		}
+		if(*item_end != 0 || first < 0 || last < first || last >= CPU_SETSIZE) {
+			error = "Invalid CPU list entry '" + item + "'";
+			return false;
+		}
+		if(num_cpus > 0 && last >= num_cpus) {
+			error = "CPU " + std::to_string(last) + " does not exist";
+			return false;
+		}
+		for(long cpu = first; cpu <= last; ++cpu) {
+			result.push_back(int(cpu));
+		}
+	}
+	cpus = std::move(result);
+	return true;
+}
+
+bool apply_thread_config(pthread_t thread, const thread_config_t& config, std::string& error)
+{
+	bool is_ok = true;
+	error.clear();
+
+	if(!config.cpus.empty())
+	{
+		cpu_set_t set;
+		CPU_ZERO(&set);
+		for(const int cpu : config.cpus) {
+			CPU_SET(cpu, &set);
+		}
+		const int res = ::pthread_setaffinity_np(thread, sizeof(set), &set);
+		if(res != 0) {
+			error += std::string("pthread_setaffinity_np() failed: ") + ::strerror(res);
+			is_ok = false;
+		}
+	}
+	if(config.priority > 0)
+	{
+		sched_param param = {};
+		param.sched_priority = config.priority;
+		const int res = ::pthread_setschedparam(thread, SCHED_FIFO, &param);
+		if(res != 0) {
+			error += std::string(is_ok ? "" : ", ") + "pthread_setschedparam(SCHED_FIFO, "
+					+ std::to_string(config.priority) + ") failed: " + ::strerror(res);
+			is_ok = false;
+		}
+	}
+	return is_ok;
+}
+
+pid_t get_thread_id()
+{
+	static thread_local const pid_t tid = ::syscall(SYS_gettid);
+	return tid;
+}
+
+bool save_thread_state(thread_state_t& state, std::string& error)
+{
+	const pthread_t self = ::pthread_self();
+	int res = ::pthread_getschedparam(self, &state.policy, &state.param);
+	if(res != 0) {
+		error = std::string("pthread_getschedparam() failed: ") + ::strerror(res);
+		return false;
+	}
+	res = ::pthread_getaffinity_np(self, sizeof(state.cpus), &state.cpus);
+	if(res != 0) {
+		error = std::string("pthread_getaffinity_np() failed: ") + ::strerror(res);
+		return false;
+	}
+	state.tid = get_thread_id();
+	return true;
+}
+
+bool restore_thread_state(const thread_state_t& state, std::string& error)
+{
+	bool is_ok = true;
+	error.clear();
+
+	if(state.tid == 0) {
+		return true;
+	}
+	// scheduling first, so the thread does not run with high priority on CPUs it should not use
+	if(::sched_setscheduler(state.tid, state.policy, &state.param) != 0 && errno != ESRCH) {
+		error += std::string("sched_setscheduler() failed: ") + ::strerror(errno);
+		is_ok = false;
+	}
+	if(::sched_setaffinity(state.tid, sizeof(state.cpus), &state.cpus) != 0 && errno != ESRCH) {
+		error += std::string(is_ok ? "" : ", ") + "sched_setaffinity() failed: " + ::strerror(errno);
+		is_ok = false;
+	}
+	return is_ok;
+}
+
+size_t prefault_stack(size_t size)
+{
+	// room for the frames above us and the callee frames of the caller's cycle
+	static const size_t margin = 64 * 1024;
+
+	if(size == 0) {
+		return 0;
+	}
+	pthread_attr_t attr;
+	if(::pthread_getattr_np(::pthread_self(), &attr) != 0) {
+		return 0;
+	}
+	void* stack_addr = 0;
+	size_t stack_size = 0;
+	const int res = ::pthread_attr_getstack(&attr, &stack_addr, &stack_size);
+	::pthread_attr_destroy(&attr);
+	if(res != 0) {
+		return 0;
+	}
+	// stack grows down towards stack_addr
+	const char* stack_pos = reinterpret_cast<const char*>(&attr);
+	const size_t available = stack_pos - static_cast<const char*>(stack_addr);
+	if(available <= margin) {
+		return 0;
+	}
+	size = std::min(size, available - margin);
+
+	// one write per page is enough to map it
+	volatile unsigned char* stack = static_cast<volatile unsigned char*>(::alloca(size));
+	const size_t page_size = ::sysconf(_SC_PAGESIZE);
+	for(size_t i = 0; i < size; i += page_size) {
+		stack[i] = 0;
+	}
+	stack[size - 1] = 0;
+	return size;
+}
+
+
+} // neo_local_planner
@@ -0,0 +1,248 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2016, Neobotix GmbH
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Neobotix nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+#include "../include/WorkerPool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <exception>
+
+
+namespace neo_local_planner {
+
+// pool and queue index of the calling thread, if it is a worker
+static thread_local const WorkerPool* g_worker_pool = 0;
+static thread_local size_t g_worker_index = 0;
+
+WorkerPool::WorkerPool(int num_threads, const thread_config_t& config)
+	:	m_config(config)
+{
+	if(num_threads <= 0) {
+		num_threads = std::max(int(std::thread::hardware_concurrency()), 1);
+	}
+	for(int i = 0; i < num_threads; ++i) {
+		m_queues.emplace_back(new queue_t());
+	}
+	for(int i = 0; i < num_threads; ++i)
+	{
+		m_threads.emplace_back(&WorkerPool::workerMain, this, i, config.prefault_stack);
+
+		std::string error;
+		if(!apply_thread_config(m_threads.back().native_handle(), config, error) && m_config_error.empty()) {
+			m_config_error = error;
+		}
+	}
+}
+
+WorkerPool::~WorkerPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_do_run = false;
+	}
+	m_condition.notify_all();
+
+	for(auto& thread : m_threads) {
+		thread.join();
+	}
+}
+
+void WorkerPool::submit(task_t task)
+{
+	const size_t index = g_worker_pool == this ? g_worker_index : m_next_queue++ % m_queues.size();
+	{
+		// count before the task becomes visible, tryPop() decrements under the queue lock after removing it
+		std::lock_guard<std::mutex> lock(m_mutex);
+		std::lock_guard<std::mutex> queue_lock(m_queues[index]->mutex);
+		m_num_queued++;
+		m_queues[index]->tasks.push_back(std::move(task));
+	}
+	m_condition.notify_one();
+}
+
+bool WorkerPool::tryPop(task_t& task)
+{
+	const bool is_worker = g_worker_pool == this;
+	const size_t own_index = is_worker ? g_worker_index : 0;
+
+	for(size_t i = 0; i < m_queues.size(); ++i)
+	{
+		queue_t& queue = *m_queues[(own_index + i) % m_queues.size()];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+
+		if(queue.tasks.empty()) {
+			continue;
+		}
+		if(is_worker && i == 0)
+		{
+			// own queue, take most recent task
+			task = std::move(queue.tasks.back());
+			queue.tasks.pop_back();
+		}
+		else
+		{
+			// steal oldest task
+			task = std::move(queue.tasks.front());
+			queue.tasks.pop_front();
+		}
+		m_num_queued--;
+		return true;
+	}
+	return false;
+}
+
+void WorkerPool::parallelFor(size_t count, const std::function<void(size_t)>& func)
+{
+	if(count == 0) {
+		return;
+	}
+	if(count == 1) {
+		func(0);
+		return;
+	}
+
+	struct batch_t {
+		std::atomic<size_t> next {0};
+		std::atomic<size_t> num_done {0};
+		std::mutex mutex;
+		std::condition_variable condition;
+		std::exception_ptr error;
+	};
+	const auto batch = std::make_shared<batch_t>();
+
+	// helpers may still run after we returned, they only touch func while work is left
+	const auto run = [batch, count, &func]()
+	{
+		size_t num_done = 0;
+		while(true)
+		{
+			const size_t i = batch->next++;
+			if(i >= count) {
+				break;
+			}
+			try {
+				func(i);
+			} catch(...) {
+				std::lock_guard<std::mutex> lock(batch->mutex);
+				if(!batch->error) {
+					batch->error = std::current_exception();
+				}
+			}
+			num_done++;
+		}
+		if(num_done > 0 && batch->num_done.fetch_add(num_done) + num_done == count)
+		{
+			std::lock_guard<std::mutex> lock(batch->mutex);
+			batch->condition.notify_all();
+		}
+	};
+
+	const size_t num_helpers = std::min(count - 1, m_threads.size());
+	for(size_t i = 0; i < num_helpers; ++i) {
+		submit(run);
+	}
+	run();
+
+	// help out with other work until all items are done
+	while(batch->num_done < count)
+	{
+		task_t task;
+		if(tryPop(task)) {
+			task();
+			continue;
+		}
+		std::unique_lock<std::mutex> lock(batch->mutex);
+		batch->condition.wait_for(lock, std::chrono::milliseconds(1),
+									[&batch, count]() { return batch->num_done >= count; });
+	}
+
+	if(batch->error) {
+		std::rethrow_exception(batch->error);
+	}
+}
+
+void WorkerPool::workerMain(int index, size_t prefault_stack_size)
+{
+	g_worker_pool = this;
+	g_worker_index = index;
+	prefault_stack(prefault_stack_size);
+
+	while(true)
+	{
+		task_t task;
+		if(tryPop(task)) {
+			task();
+			continue;
+		}
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_condition.wait(lock, [this]() { return m_num_queued > 0 || !m_do_run; });
+
+		if(!m_do_run && m_num_queued == 0) {
+			break;
+		}
+	}
+}
+
+bool WorkerPool::isWorkerThread()
+{
+	return g_worker_pool != 0;
+}
+
+std::shared_ptr<WorkerPool> WorkerPool::getShared(int num_threads, const thread_config_t& config, std::string& error)
+{
+	static std::mutex mutex;
+	static std::weak_ptr<WorkerPool> instance;
+
+	std::lock_guard<std::mutex> lock(mutex);
+	auto pool = instance.lock();
+	if(!pool) {
+		pool = std::make_shared<WorkerPool>(num_threads, config);
+		instance = pool;
+		return pool;
+	}
+	const int wanted_threads = num_threads > 0 ? num_threads : std::max(int(std::thread::hardware_concurrency()), 1);
+	if(wanted_threads != pool->numThreads()) {
+		error = "shared pool already running with " + std::to_string(pool->numThreads())
+				+ " threads, requested " + std::to_string(wanted_threads);
+	}
+	else if(config.cpus != pool->m_config.cpus || config.priority != pool->m_config.priority
+			|| config.prefault_stack != pool->m_config.prefault_stack)
+	{
+		error = "shared pool already running with a different thread placement";
+	}
+	return pool;
+}
+
+
+} // neo_local_planner
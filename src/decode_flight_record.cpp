@@ -0,0 +1,147 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2016, Neobotix GmbH
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Neobotix nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+/*
+ * Prints a flight recorder dump as CSV, the latest one unless a reason is given.
+ * All dumps found in the file are listed on stderr.
+ *
+ * Usage: decode_flight_record <file> [requested|stuck|emergency_brake]
+ */
+
+#include "../include/FlightRecorder.h"
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+using namespace neo_local_planner;
+
+
+int main(int argc, char** argv)
+{
+	static const char* reasons[NUM_DUMP_REASONS] = {"requested", "stuck", "emergency_brake"};
+
+	if(argc < 2) {
+		fprintf(stderr, "Usage: %s <file> [requested|stuck|emergency_brake]\n", argv[0]);
+		return 1;
+	}
+	int wanted_reason = -1;
+	if(argc > 2)
+	{
+		for(int i = 0; i < NUM_DUMP_REASONS; ++i) {
+			if(strcmp(argv[2], reasons[i]) == 0) {
+				wanted_reason = i;
+			}
+		}
+		if(wanted_reason < 0) {
+			fprintf(stderr, "Unknown reason %s\n", argv[2]);
+			return 1;
+		}
+	}
+	FILE* file = fopen(argv[1], "rb");
+	if(!file) {
+		fprintf(stderr, "Failed to open %s\n", argv[1]);
+		return 1;
+	}
+
+	// slot size follows from the file size, a slot which was never dumped has no header
+	fseek(file, 0, SEEK_END);
+	const long file_size = ftell(file);
+	const long slot_size = file_size / NUM_DUMP_REASONS;
+	if(file_size <= 0 || file_size % NUM_DUMP_REASONS != 0 || slot_size < long(sizeof(flight_record_header_t))
+		|| (slot_size - sizeof(flight_record_header_t)) % sizeof(flight_record_t) != 0)
+	{
+		fprintf(stderr, "%s is not a flight record of version %u\n", argv[1], flight_record_version);
+		fclose(file);
+		return 1;
+	}
+
+	int slot = -1;
+	flight_record_header_t header;
+	for(int i = 0; i < NUM_DUMP_REASONS; ++i)
+	{
+		flight_record_header_t slot_header;
+		fseek(file, i * slot_size, SEEK_SET);
+		if(fread(&slot_header, sizeof(slot_header), 1, file) != 1
+			|| memcmp(slot_header.magic, flight_record_magic, sizeof(slot_header.magic)) != 0
+			|| slot_header.version != flight_record_version || slot_header.record_size != sizeof(flight_record_t)
+			|| slot_header.reason != uint32_t(i)
+			|| slot_header.num_records * sizeof(flight_record_t) > slot_size - sizeof(flight_record_header_t))
+		{
+			continue;
+		}
+		fprintf(stderr, "dump #%lu, reason: %s, %u records\n", (unsigned long)slot_header.dump_count,
+				reasons[i], slot_header.num_records);
+
+		if(wanted_reason >= 0 ? i == wanted_reason : (slot < 0 || slot_header.dump_count > header.dump_count)) {
+			slot = i;
+			header = slot_header;
+		}
+	}
+	if(slot < 0) {
+		fprintf(stderr, "%s holds no %s dump\n", argv[1], wanted_reason >= 0 ? reasons[wanted_reason] : "valid");
+		fclose(file);
+		return 1;
+	}
+
+	std::vector<flight_record_t> records(header.num_records);
+	fseek(file, slot * slot_size + sizeof(flight_record_header_t), SEEK_SET);
+	if(fread(records.data(), sizeof(flight_record_t), records.size(), file) != records.size()) {
+		fprintf(stderr, "File is truncated\n");
+		fclose(file);
+		return 1;
+	}
+	fclose(file);
+
+	fprintf(stderr, "printing dump #%lu (%s)\n", (unsigned long)header.dump_count, reasons[slot]);
+
+	printf("cycle,stamp,x,y,yaw,pos_error_x,pos_error_y,yaw_error,center_cost,delta_cost_x,delta_cost_y,delta_cost_yaw,"
+			"obstacle_dist,pose_latency,odom_latency,control_vel_x,control_vel_y,control_yawrate,cmd_vel_x,cmd_vel_y,cmd_yawrate,"
+			"time_predict,time_gradients,time_scan,time_path,time_control,state,have_obstacle,goal_target,emergency_brake,degrade_level\n");
+
+	for(const auto& r : records)
+	{
+		printf("%lu,%.9f,%f,%f,%f,%f,%f,%f,%f,%f,%f,%f,%f,%f,%f,%f,%f,%f,%f,%f,%f,%u,%u,%u,%u,%u,%u,%d,%d,%d,%u\n",
+				(unsigned long)r.cycle, r.stamp * 1e-9,
+				r.pose[0], r.pose[1], r.pose[2], r.pos_error[0], r.pos_error[1], r.yaw_error,
+				r.center_cost, r.delta_cost[0], r.delta_cost[1], r.delta_cost[2],
+				r.obstacle_dist, r.pose_latency, r.odom_latency,
+				r.control_vel[0], r.control_vel[1], r.control_vel[2], r.cmd_vel[0], r.cmd_vel[1], r.cmd_vel[2],
+				r.stage_time[STAGE_PREDICT], r.stage_time[STAGE_GRADIENTS], r.stage_time[STAGE_SCAN],
+				r.stage_time[STAGE_PATH], r.stage_time[STAGE_CONTROL], unsigned(r.state),
+				(r.flags & RECORD_HAVE_OBSTACLE) ? 1 : 0, (r.flags & RECORD_GOAL_TARGET) ? 1 : 0,
+				(r.flags & RECORD_EMERGENCY_BRAKE) ? 1 : 0, unsigned(r.degrade_level));
+	}
+	return 0;
+}
@@ -0,0 +1,284 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2016, Neobotix GmbH
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Neobotix nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+
+/*
+ * Measures wake-up and completion jitter of a periodic cycle with a given thread placement,
+ * optionally while other threads load the CPUs. Use it to verify control_cpus / control_priority
+ * on a robot before setting them for the planner.
+ *
+ * Usage: measure_jitter [options]
+ *   --rate <hz>             cycle rate (default 20)
+ *   --duration <sec>        measurement time (default 10)
+ *   --work <sec>            synthetic work per cycle, calibrated when idle (default 0.005)
+ *   --cpus <list>           CPUs of the cycle thread, eg. "2,3" or "2-3"
+ *   --priority <n>          SCHED_FIFO priority of the cycle thread, 0 = normal (default 0)
+ *   --prefault <bytes>      stack to prefault on the cycle thread
+ *   --mlock                 lock all memory with mlockall()
+ *   --load-threads <n>      number of CPU load threads (default 0)
+ *   --load-cpus <list>      CPUs of the load threads
+ */
+
+#include "../include/ThreadPlacement.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/mman.h>
+#include <time.h>
+
+using namespace neo_local_planner;
+
+
+static int64_t to_nsec(const timespec& time)
+{
+	return int64_t(time.tv_sec) * 1000000000 + time.tv_nsec;
+}
+
+static timespec to_timespec(int64_t nsec)
+{
+	timespec time;
+	time.tv_sec = nsec / 1000000000;
+	time.tv_nsec = nsec % 1000000000;
+	return time;
+}
+
+static int64_t now_nsec()
+{
+	timespec time;
+	::clock_gettime(CLOCK_MONOTONIC, &time);
+	return to_nsec(time);
+}
+
+/*
+ * Fixed amount of floating point and memory work, returns a value to keep it from being optimized away.
+ */
+static double synthetic_work(uint64_t iterations, std::vector<double>& buffer)
+{
+	double sum = 0;
+	for(uint64_t i = 0; i < iterations; ++i)
+	{
+		double& value = buffer[(i * 64) % buffer.size()];
+		value = std::sqrt(value + i);
+		sum += value;
+	}
+	return sum;
+}
+
+struct stats_t {
+	double mean = 0;
+	double std_dev = 0;
+	double p99 = 0;
+	double max = 0;
+};
+
+static stats_t compute_stats(std::vector<double> values)
+{
+	stats_t stats;
+	if(values.empty()) {
+		return stats;
+	}
+	for(const double value : values) {
+		stats.mean += value;
+	}
+	stats.mean /= values.size();
+	for(const double value : values) {
+		stats.std_dev += (value - stats.mean) * (value - stats.mean);
+	}
+	stats.std_dev = std::sqrt(stats.std_dev / values.size());
+
+	std::sort(values.begin(), values.end());
+	stats.p99 = values[std::min(size_t(values.size() * 0.99), values.size() - 1)];
+	stats.max = values.back();
+	return stats;
+}
+
+static void print_stats(const char* name, const stats_t& stats)
+{
+	printf("%s [us]: mean=%.1f std_dev=%.1f p99=%.1f max=%.1f\n",
+			name, stats.mean * 1e6, stats.std_dev * 1e6, stats.p99 * 1e6, stats.max * 1e6);
+}
+
+
+int main(int argc, char** argv)
+{
+	double rate = 20;
+	double duration = 10;
+	double work_time = 0.005;
+	bool use_mlock = false;
+	int num_load_threads = 0;
+	thread_config_t cycle_config;
+	thread_config_t load_config;
+
+	for(int i = 1; i < argc; ++i)
+	{
+		const std::string arg = argv[i];
+		const bool have_value = i + 1 < argc;
+		std::string error;
+		if(arg == "--rate" && have_value) {
+			rate = atof(argv[++i]);
+		} else if(arg == "--duration" && have_value) {
+			duration = atof(argv[++i]);
+		} else if(arg == "--work" && have_value) {
+			work_time = std::max(atof(argv[++i]), 0.);
+		} else if(arg == "--cpus" && have_value) {
+			if(!parse_cpu_list(argv[++i], cycle_config.cpus, error)) {
+				fprintf(stderr, "--cpus: %s\n", error.c_str());
+				return 1;
+			}
+		} else if(arg == "--priority" && have_value) {
+			cycle_config.priority = atoi(argv[++i]);
+		} else if(arg == "--prefault" && have_value) {
+			cycle_config.prefault_stack = std::max(atol(argv[++i]), 0l);
+		} else if(arg == "--mlock") {
+			use_mlock = true;
+		} else if(arg == "--load-threads" && have_value) {
+			num_load_threads = std::max(atoi(argv[++i]), 0);
+		} else if(arg == "--load-cpus" && have_value) {
+			if(!parse_cpu_list(argv[++i], load_config.cpus, error)) {
+				fprintf(stderr, "--load-cpus: %s\n", error.c_str());
+				return 1;
+			}
+		} else {
+			fprintf(stderr, "Usage: %s [--rate <hz>] [--duration <sec>] [--work <sec>] [--cpus <list>] [--priority <n>]\n"
+							"\t[--prefault <bytes>] [--mlock] [--load-threads <n>] [--load-cpus <list>]\n", argv[0]);
+			return 1;
+		}
+	}
+	if(rate <= 0 || duration <= 0) {
+		fprintf(stderr, "Rate and duration need to be positive\n");
+		return 1;
+	}
+	const int64_t period = int64_t(1e9 / rate);
+	const size_t num_cycles = size_t(duration * rate);
+
+	// calibrate work on an idle system, before placement and load
+	std::vector<double> buffer(1 << 16, 1);
+	uint64_t work_iterations = 0;
+	if(work_time > 0)
+	{
+		const uint64_t test_iterations = 1000000;
+		const int64_t time_begin = now_nsec();
+		synthetic_work(test_iterations, buffer);
+		const double test_time = std::max(now_nsec() - time_begin, int64_t(1)) * 1e-9;
+		work_iterations = uint64_t(test_iterations * work_time / test_time);
+	}
+
+	if(use_mlock && ::mlockall(MCL_CURRENT | MCL_FUTURE) != 0) {
+		fprintf(stderr, "mlockall() failed: %s\n", strerror(errno));
+	}
+
+	// load generator, spins on its own memory
+	std::atomic<bool> do_load {true};
+	std::vector<std::thread> load_threads;
+	for(int i = 0; i < num_load_threads; ++i)
+	{
+		load_threads.emplace_back([&do_load]()
+		{
+			std::vector<double> load_buffer(1 << 20, 1);
+			volatile double sink = 0;
+			while(do_load) {
+				sink = sink + synthetic_work(100000, load_buffer);
+			}
+		});
+		std::string error;
+		if(!apply_thread_config(load_threads.back().native_handle(), load_config, error)) {
+			fprintf(stderr, "Load thread placement failed: %s\n", error.c_str());
+		}
+	}
+
+	// cycle thread, wakes up at absolute times like a timer driven control loop
+	std::vector<double> wakeup_latency;
+	std::vector<double> completion_time;
+	size_t num_overruns = 0;
+	volatile double sink = 0;
+
+	std::thread cycle_thread([&]()
+	{
+		const size_t prefault_size = prefault_stack(cycle_config.prefault_stack);
+		if(prefault_size < cycle_config.prefault_stack) {
+			fprintf(stderr, "Stack only has room to prefault %zu bytes\n", prefault_size);
+		}
+		wakeup_latency.reserve(num_cycles);
+		completion_time.reserve(num_cycles);
+
+		int64_t next_time = now_nsec() + period;
+		for(size_t i = 0; i < num_cycles; ++i)
+		{
+			const timespec wakeup = to_timespec(next_time);
+			while(::clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &wakeup, 0) == EINTR);
+
+			const int64_t time_begin = now_nsec();
+			sink = sink + synthetic_work(work_iterations, buffer);
+			const int64_t time_end = now_nsec();
+
+			wakeup_latency.push_back((time_begin - next_time) * 1e-9);
+			completion_time.push_back((time_end - next_time) * 1e-9);
+
+			// skip missed periods, same as PeriodicTask
+			next_time += period;
+			if(time_end > next_time) {
+				num_overruns++;
+				next_time += ((time_end - next_time) / period + 1) * period;
+			}
+		}
+	});
+	{
+		std::string error;
+		if(!apply_thread_config(cycle_thread.native_handle(), cycle_config, error)) {
+			fprintf(stderr, "Cycle thread placement failed: %s\n", error.c_str());
+		}
+	}
+	cycle_thread.join();
+
+	do_load = false;
+	for(auto& thread : load_threads) {
+		thread.join();
+	}
+
+	printf("cycles: %zu at %.1f Hz, work %.3f ms, %d load threads\n", num_cycles, rate, work_time * 1e3, num_load_threads);
+	print_stats("wake-up latency", compute_stats(wakeup_latency));
+	print_stats("completion time", compute_stats(completion_time));
+	printf("overruns: %zu\n", num_overruns);
+	return 0;
+}
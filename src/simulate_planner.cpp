@@ -0,0 +1,196 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2016, Neobotix GmbH
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Neobotix nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+
+/*
+ * Runs closed loop simulations of the planner (see KinematicSimulator) and prints the results as CSV.
+ *
+ * Usage: simulate_planner [options] <scenario file>...
+ *   --params <file>         ROS parameter file, give the parameters for all nodes (wildcard node name)
+ *   --plugin <name>         planner name, prefix of its parameters (default FollowPath)
+ *   --drive <model>         differential or holonomic (default differential)
+ *   --rate <hz>             control rate (default 20)
+ *   --lag <sec>             actuator time constant (default 0.1)
+ *   --noise-pos <m>         odometry noise std dev
+ *   --noise-yaw <rad>
+ *   --noise-vel <m/s>
+ *   --repeat <n>            runs per scenario, each with a different noise seed (default 1)
+ *   --threads <n>           parallel runs, 0 = all cores (default 0)
+ *   --check                 exit with 2 if any run collides or misses the goal before the scenario timeout
+ *
+ * Every run gets its own node and flight recorder file (/tmp/neo_simulator_<pid>_<run>_<scenario>.bin),
+ * flight_recorder_file in the params file is overridden.
+ */
+
+#include "../include/KinematicSimulator.h"
+#include "../include/WorkerPool.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+using namespace neo_local_planner;
+
+
+int main(int argc, char** argv)
+{
+	sim_params_t params;
+	std::string params_file;
+	int num_repeat = 1;
+	int num_threads = 0;
+	bool check = false;
+	std::vector<std::string> scenario_files;
+
+	for(int i = 1; i < argc; ++i)
+	{
+		const std::string arg = argv[i];
+		const bool have_value = i + 1 < argc;
+		if(arg == "--params" && have_value) {
+			params_file = argv[++i];
+		} else if(arg == "--plugin" && have_value) {
+			params.plugin_name = argv[++i];
+		} else if(arg == "--drive" && have_value) {
+			const std::string model = argv[++i];
+			if(model == "differential") {
+				params.drive_model = sim_params_t::DRIVE_DIFFERENTIAL;
+			} else if(model == "holonomic") {
+				params.drive_model = sim_params_t::DRIVE_HOLONOMIC;
+			} else {
+				fprintf(stderr, "Unknown drive model: %s\n", model.c_str());
+				return 1;
+			}
+		} else if(arg == "--rate" && have_value) {
+			params.control_rate = atof(argv[++i]);
+		} else if(arg == "--lag" && have_value) {
+			params.actuator_lag = atof(argv[++i]);
+		} else if(arg == "--noise-pos" && have_value) {
+			params.odom_noise_pos = atof(argv[++i]);
+		} else if(arg == "--noise-yaw" && have_value) {
+			params.odom_noise_yaw = atof(argv[++i]);
+		} else if(arg == "--noise-vel" && have_value) {
+			params.odom_noise_vel = atof(argv[++i]);
+		} else if(arg == "--repeat" && have_value) {
+			num_repeat = std::max(atoi(argv[++i]), 1);
+		} else if(arg == "--threads" && have_value) {
+			num_threads = std::max(atoi(argv[++i]), 0);
+		} else if(arg == "--check") {
+			check = true;
+		} else if(arg.compare(0, 2, "--") == 0) {
+			fprintf(stderr, "Unknown option: %s\n", arg.c_str());
+			return 1;
+		} else {
+			scenario_files.push_back(arg);
+		}
+	}
+	if(scenario_files.empty() || params.control_rate <= 0) {
+		fprintf(stderr, "Usage: %s [--params <file>] [--plugin <name>] [--drive differential|holonomic] [--rate <hz>] [--lag <sec>]\n"
+						"\t[--noise-pos <m>] [--noise-yaw <rad>] [--noise-vel <m/s>] [--repeat <n>] [--threads <n>] [--check] <scenario file>...\n", argv[0]);
+		return 1;
+	}
+
+	std::vector<sim_scenario_t> scenarios(scenario_files.size());
+	for(size_t i = 0; i < scenarios.size(); ++i)
+	{
+		std::string error;
+		if(!load_scenario(scenario_files[i], scenarios[i], error)) {
+			fprintf(stderr, "%s\n", error.c_str());
+			return 1;
+		}
+	}
+
+	// our own arguments are not meant for ROS
+	rclcpp::init(1, argv);
+
+	rclcpp::NodeOptions options;
+	options.start_parameter_services(false);
+	options.start_parameter_event_publisher(false);
+	if(!params_file.empty()) {
+		options.arguments({"--ros-args", "--params-file", params_file});
+	}
+
+	const size_t num_runs = scenarios.size() * num_repeat;
+	std::vector<sim_result_t> results(num_runs);
+	std::vector<unsigned int> seeds(num_runs);
+
+	const auto time_begin = std::chrono::steady_clock::now();
+	try {
+		WorkerPool pool(num_threads);
+		pool.parallelFor(num_runs, [&](size_t i)
+		{
+			sim_params_t run_params = params;
+			run_params.seed = params.seed + i / scenarios.size();
+			seeds[i] = run_params.seed;
+
+			// runs share the plugin name, keep their flight records apart
+			const sim_scenario_t& scenario = scenarios[i % scenarios.size()];
+			rclcpp::NodeOptions run_options = options;
+			run_options.parameter_overrides({rclcpp::Parameter(params.plugin_name + ".flight_recorder_file",
+					"/tmp/neo_simulator_" + std::to_string(::getpid()) + "_" + std::to_string(i) + "_" + scenario.name + ".bin")});
+
+			KinematicSimulator simulator(scenario, run_params, "neo_simulator_" + std::to_string(i), run_options);
+			results[i] = simulator.run();
+		});
+	} catch(const std::exception& ex) {
+		fprintf(stderr, "Simulation failed: %s\n", ex.what());
+		rclcpp::shutdown();
+		return 1;
+	}
+	const double wall_time = std::chrono::duration<double>(std::chrono::steady_clock::now() - time_begin).count();
+
+	printf("scenario,seed,goal_reached,collision,completion_time,mean_tracking_error,max_tracking_error,min_clearance,"
+			"num_cycles,mean_cycle_time,p99_cycle_time,max_cycle_time,real_time_factor\n");
+
+	size_t num_reached = 0;
+	size_t num_collisions = 0;
+	for(size_t i = 0; i < num_runs; ++i)
+	{
+		const sim_result_t& r = results[i];
+		printf("%s,%u,%d,%d,%f,%f,%f,%f,%zu,%f,%f,%f,%f\n",
+				r.name.c_str(), seeds[i], r.is_goal_reached ? 1 : 0, r.is_collision ? 1 : 0,
+				r.completion_time, r.mean_tracking_error, r.max_tracking_error, r.min_clearance,
+				r.num_cycles, r.mean_cycle_time, r.p99_cycle_time, r.max_cycle_time, r.real_time_factor);
+		num_reached += r.is_goal_reached ? 1 : 0;
+		num_collisions += r.is_collision ? 1 : 0;
+	}
+	fprintf(stderr, "%zu runs in %f sec: %zu reached goal, %zu collisions\n", num_runs, wall_time, num_reached, num_collisions);
+
+	rclcpp::shutdown();
+	return check && (num_reached < num_runs || num_collisions > 0) ? 2 : 0;
+}
@@ -0,0 +1,176 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2016, Neobotix GmbH
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Neobotix nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+/*
+ * Measures planner throughput in robots x Hz per core, sequential against
+ * NeoLocalPlanner::computeVelocityCommandsBatch() on a shared WorkerPool.
+ *
+ * Usage: benchmark_batch [options]
+ *   --robots <n>            planner instances, one lane each (default 50)
+ *   --threads <n>           pool size, 0 = all cores (default 0)
+ *   --cycles <n>            measured cycles per robot (default 200)
+ */
+
+#include "planner_test_utils.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+using namespace neo_local_planner;
+
+
+static const double lane_width = 2;		// [m]
+static const double lane_length = 20;	// [m]
+static const double dt = 0.05;			// simulated cycle time [s]
+
+struct robot_t {
+	std::shared_ptr<NeoLocalPlanner> planner;
+	double pose[3] = {};
+};
+
+static void advance(robot_t& robot, const geometry_msgs::msg::TwistStamped& cmd_vel)
+{
+	const double yaw = robot.pose[2] + cmd_vel.twist.angular.z * dt / 2;
+	robot.pose[0] += cmd_vel.twist.linear.x * cos(yaw) * dt;
+	robot.pose[1] += cmd_vel.twist.linear.x * sin(yaw) * dt;
+	robot.pose[2] += cmd_vel.twist.angular.z * dt;
+}
+
+static double run_sequential(test::PlannerEnvironment& env, std::vector<robot_t>& robots, int num_cycles)
+{
+	const auto time_begin = std::chrono::steady_clock::now();
+	for(int k = 0; k < num_cycles; ++k) {
+		for(auto& robot : robots)
+		{
+			const auto odom = env.makeOdom(robot.pose[0], robot.pose[1], robot.pose[2], 0, 0);
+			robot.planner->odomCallback(odom);
+			advance(robot, robot.planner->computeVelocityCommands(test::PlannerEnvironment::toPose(*odom), odom->twist.twist));
+		}
+	}
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - time_begin).count();
+}
+
+static double run_batch(test::PlannerEnvironment& env, std::vector<robot_t>& robots, int num_cycles, WorkerPool& pool)
+{
+	std::vector<NeoLocalPlanner::batch_item_t> batch(robots.size());
+	double wall_time = 0;
+	for(int k = 0; k < num_cycles; ++k)
+	{
+		for(size_t i = 0; i < robots.size(); ++i)
+		{
+			const auto odom = env.makeOdom(robots[i].pose[0], robots[i].pose[1], robots[i].pose[2], 0, 0);
+			robots[i].planner->odomCallback(odom);
+			batch[i].planner = robots[i].planner.get();
+			batch[i].pose = test::PlannerEnvironment::toPose(*odom);
+			batch[i].speed = odom->twist.twist;
+		}
+		wall_time += NeoLocalPlanner::computeVelocityCommandsBatch(batch, pool).wall_time;
+
+		for(size_t i = 0; i < robots.size(); ++i) {
+			advance(robots[i], batch[i].cmd_vel);
+		}
+	}
+	return wall_time;
+}
+
+static void reset(test::PlannerEnvironment& env, std::vector<robot_t>& robots)
+{
+	for(size_t i = 0; i < robots.size(); ++i)
+	{
+		robot_t& robot = robots[i];
+		robot.pose[0] = 0;
+		robot.pose[1] = (i + 0.5) * lane_width;
+		robot.pose[2] = 0;
+		robot.planner->setPlan(env.makeStraightPlan(0, robot.pose[1], 0, lane_length, 0.05));
+	}
+}
+
+int main(int argc, char** argv)
+{
+	int num_robots = 50;
+	int num_threads = 0;
+	int num_cycles = 200;
+
+	for(int i = 1; i < argc; ++i)
+	{
+		const std::string arg = argv[i];
+		const bool have_value = i + 1 < argc;
+		if(arg == "--robots" && have_value) {
+			num_robots = std::max(atoi(argv[++i]), 1);
+		} else if(arg == "--threads" && have_value) {
+			num_threads = std::max(atoi(argv[++i]), 0);
+		} else if(arg == "--cycles" && have_value) {
+			num_cycles = std::max(atoi(argv[++i]), 1);
+		} else {
+			fprintf(stderr, "Usage: %s [--robots <n>] [--threads <n>] [--cycles <n>]\n", argv[0]);
+			return 1;
+		}
+	}
+	rclcpp::init(argc, argv);
+	{
+		// lanes with an obstacle halfway, so every robot scans and slows down
+		test::PlannerEnvironment env("benchmark_batch", lane_length + 4, num_robots * lane_width, 0.05, -2, 0);
+		for(int i = 0; i < num_robots; ++i) {
+			env.addBox(lane_length / 2, (i + 0.6) * lane_width, lane_length / 2 + 0.5, (i + 0.9) * lane_width);
+		}
+
+		std::vector<robot_t> robots(num_robots);
+		for(int i = 0; i < num_robots; ++i) {
+			robots[i].planner = env.createPlanner("robot_" + std::to_string(i));
+		}
+		WorkerPool pool(num_threads);
+
+		reset(env, robots);
+		const double sequential_time = run_sequential(env, robots, num_cycles);
+		reset(env, robots);
+		const double batch_time = run_batch(env, robots, num_cycles, pool);
+
+		const double num_total = double(num_robots) * num_cycles;
+		printf("robots=%d, cycles=%d, threads=%d\n", num_robots, num_cycles, pool.numThreads());
+		printf("sequential: %.3f ms per cycle, %.1f robots x Hz per core\n",
+				sequential_time / num_total * 1e3, num_total / sequential_time);
+		printf("batch:      %.3f ms per cycle, %.1f robots x Hz per core (%.1f total)\n",
+				batch_time / num_total * 1e3, num_total / batch_time / pool.numThreads(), num_total / batch_time);
+
+		for(auto& robot : robots) {
+			robot.planner->deactivate();
+			robot.planner->cleanup();
+		}
+	}
+	rclcpp::shutdown();
+	return 0;
+}
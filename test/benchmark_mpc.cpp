@@ -0,0 +1,156 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2016, Neobotix GmbH
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Neobotix nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+/*
+ * Measures MpcSolver solve time against horizon length at a fixed iteration budget,
+ * warm started like in the control loop (one solve per cycle while the reference moves on).
+ *
+ * Usage: benchmark_mpc [options]
+ *   --iterations <n>        max iterations per solve (default 20)
+ *   --solves <n>            solves per horizon (default 2000)
+ */
+
+#include "../include/MpcSolver.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+using namespace neo_local_planner;
+
+
+// gaussian blob next to the path
+static double blob_cost(double x, double y, double* grad)
+{
+	const double dx = x - 2;
+	const double dy = y - 0.3;
+	const double cost = exp(-(dx * dx + dy * dy) / 0.1);
+	grad[0] = -cost * 2 * dx / 0.1;
+	grad[1] = -cost * 2 * dy / 0.1;
+	return cost;
+}
+
+int main(int argc, char** argv)
+{
+	int max_iterations = 20;
+	int num_solves = 2000;
+
+	for(int i = 1; i < argc; ++i)
+	{
+		const std::string arg = argv[i];
+		const bool have_value = i + 1 < argc;
+		if(arg == "--iterations" && have_value) {
+			max_iterations = std::max(atoi(argv[++i]), 1);
+		} else if(arg == "--solves" && have_value) {
+			num_solves = std::max(atoi(argv[++i]), 1);
+		} else {
+			fprintf(stderr, "Usage: %s [--iterations <n>] [--solves <n>]\n", argv[0]);
+			return 1;
+		}
+	}
+	const MpcSolver::cost_func_t cost_func = blob_cost;
+
+	printf("horizon, mean_us, p99_us, max_us, mean_iterations, cost_reduction\n");
+	for(const int horizon : {5, 10, 15, 20, 30, 40})
+	{
+		MpcSolver::params_t params;
+		params.horizon = horizon;
+		params.dt = 0.1;
+		params.max_iterations = max_iterations;
+		params.min_vel.vx = -0.1;
+		params.max_vel.vx = 0.8;
+		params.min_vel.vy = -0.3;
+		params.max_vel.vy = 0.3;
+		params.min_vel.yawrate = -1;
+		params.max_vel.yawrate = 1;
+		params.acc_lim.vx = 0.5;
+		params.acc_lim.vy = 0.5;
+		params.acc_lim.yawrate = 1;
+
+		MpcSolver solver;
+		solver.setParams(params);
+
+		std::vector<MpcSolver::pose_t> reference(horizon + 1);
+		std::vector<double> times;
+		times.reserve(num_solves);
+		double sum_iterations = 0;
+		double sum_reduction = 0;
+
+		// robot follows a gentle curve, commands are applied with one cycle period of 50 ms
+		MpcSolver::pose_t pose;
+		MpcSolver::control_t vel;
+		for(int i = 0; i < num_solves; ++i)
+		{
+			if(pose.x > 4) {
+				pose = MpcSolver::pose_t();
+				vel = MpcSolver::control_t();
+				solver.reset();
+			}
+			for(int k = 0; k <= horizon; ++k)
+			{
+				MpcSolver::pose_t& ref = reference[k];
+				ref.x = pose.x + 0.8 * k * params.dt;
+				ref.y = 0.2 * sin(ref.x);
+				ref.yaw = atan(0.2 * cos(ref.x));
+			}
+
+			MpcSolver::stats_t stats;
+			const auto time_begin = std::chrono::steady_clock::now();
+			vel = solver.solve(pose, vel, reference, cost_func, &stats);
+			times.push_back(std::chrono::duration<double>(std::chrono::steady_clock::now() - time_begin).count());
+
+			sum_iterations += stats.num_iterations;
+			sum_reduction += stats.initial_cost > 0 ? 1 - stats.final_cost / stats.initial_cost : 0;
+
+			const double yaw = pose.yaw + 0.5 * vel.yawrate * 0.05;
+			pose.x += (vel.vx * cos(yaw) - vel.vy * sin(yaw)) * 0.05;
+			pose.y += (vel.vx * sin(yaw) + vel.vy * cos(yaw)) * 0.05;
+			pose.yaw += vel.yawrate * 0.05;
+		}
+
+		std::sort(times.begin(), times.end());
+		double sum = 0;
+		for(const double time : times) {
+			sum += time;
+		}
+		printf("%d, %.1f, %.1f, %.1f, %.1f, %.3f\n", horizon, sum / times.size() * 1e6,
+				times[size_t(times.size() * 0.99)] * 1e6, times.back() * 1e6,
+				sum_iterations / num_solves, sum_reduction / num_solves);
+	}
+	return 0;
+}
@@ -0,0 +1,159 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2016, Neobotix GmbH
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Neobotix nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+/*
+ * Compares control cycle time with the exact obstacle scan against the templated scan (scan_templates).
+ * Both planners see the same poses, velocities and map and never re-use a previous scan,
+ * so the difference in cycle time is the difference in scan time. Also reports build time
+ * and memory of the template table.
+ *
+ * Usage: benchmark_scan [options]
+ *   --samples <n>           random poses (default 2000)
+ *   --density <fraction>    share of lethal cells (default 0.002)
+ *   --resolution <m>        costmap resolution (default 0.05)
+ */
+
+#include "planner_test_utils.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace neo_local_planner;
+
+
+static const double map_size = 24;		// [m]
+
+static void print_stats(const char* name, std::vector<double>& times)
+{
+	std::sort(times.begin(), times.end());
+	double sum = 0;
+	for(const double time : times) {
+		sum += time;
+	}
+	printf("%-10s mean %.3f ms, median %.3f ms, p99 %.3f ms\n", name,
+			sum / times.size() * 1e3, times[times.size() / 2] * 1e3, times[size_t(times.size() * 0.99)] * 1e3);
+}
+
+int main(int argc, char** argv)
+{
+	int num_samples = 2000;
+	double density = 0.002;
+	double resolution = 0.05;
+
+	for(int i = 1; i < argc; ++i)
+	{
+		const std::string arg = argv[i];
+		const bool have_value = i + 1 < argc;
+		if(arg == "--samples" && have_value) {
+			num_samples = std::max(atoi(argv[++i]), 1);
+		} else if(arg == "--density" && have_value) {
+			density = atof(argv[++i]);
+		} else if(arg == "--resolution" && have_value) {
+			resolution = atof(argv[++i]);
+		} else {
+			fprintf(stderr, "Usage: %s [--samples <n>] [--density <fraction>] [--resolution <m>]\n", argv[0]);
+			return 1;
+		}
+	}
+	rclcpp::init(argc, argv);
+	{
+		test::PlannerEnvironment env("benchmark_scan", map_size, map_size, resolution, 0, 0);
+		env.addRandomObstacles(density, 1);
+
+		// same params as the planner builds, so it gets this table from the cache
+		ScanTemplates::params_t template_params;
+		template_params.resolution = env.getCostmap().getResolution();
+		template_params.step = 0.05;
+		template_params.max_dist = 10;
+		const auto build_begin = std::chrono::steady_clock::now();
+		const auto templates = ScanTemplates::getShared(template_params);
+		printf("templates: %zu x %d steps, built in %.3f s, %.1f MB\n",
+				templates->getNumTemplates(), templates->getNumSteps(),
+				std::chrono::duration<double>(std::chrono::steady_clock::now() - build_begin).count(),
+				templates->memoryUsage() / 1e6);
+
+		test::PlannerEnvironment::params_t params;
+		params["scan_reuse_tolerance"] = rclcpp::ParameterValue(0.0);
+		params["flight_recorder_size"] = rclcpp::ParameterValue(0);
+		params["max_vel_x"] = rclcpp::ParameterValue(1.0);
+		auto exact = env.createPlanner("exact", params);
+		params["scan_templates"] = rclcpp::ParameterValue(true);
+		auto templated = env.createPlanner("templated", params);
+
+		std::mt19937 generator(2);
+		std::uniform_real_distribution<double> position(2, map_size - 2);
+		std::uniform_real_distribution<double> yaw(-M_PI, M_PI);
+		std::uniform_real_distribution<double> vel_x(0.2, 1);
+		std::uniform_real_distribution<double> yawrate(-0.5, 0.5);
+
+		std::vector<double> exact_times;
+		std::vector<double> templated_times;
+		for(int i = 0; i < num_samples; ++i)
+		{
+			const double x = position(generator);
+			const double y = position(generator);
+			const double theta = yaw(generator);
+			const auto plan = env.makeStraightPlan(x, y, theta, 10, 0.05);
+			const auto odom = env.makeOdom(x, y, theta, vel_x(generator), yawrate(generator));
+			const auto pose = test::PlannerEnvironment::toPose(*odom);
+
+			for(int k = 0; k < 2; ++k)
+			{
+				NeoLocalPlanner& planner = k == 0 ? *exact : *templated;
+				planner.setPlan(plan);
+				planner.odomCallback(odom);
+
+				const auto time_begin = std::chrono::steady_clock::now();
+				planner.computeVelocityCommands(pose, odom->twist.twist);
+				const double time = std::chrono::duration<double>(std::chrono::steady_clock::now() - time_begin).count();
+				(k == 0 ? exact_times : templated_times).push_back(time);
+			}
+		}
+		printf("cycle time over %d poses, density %g, resolution %g m:\n", num_samples, density, resolution);
+		print_stats("exact", exact_times);
+		print_stats("templated", templated_times);
+
+		for(auto planner : {exact, templated}) {
+			planner->deactivate();
+			planner->cleanup();
+		}
+	}
+	rclcpp::shutdown();
+	return 0;
+}
@@ -0,0 +1,205 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2016, Neobotix GmbH
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Neobotix nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+/*
+ * Compares SE2 against the tf2::Transform code it replaced in the control loop:
+ * composing poses, inverting them and transforming points (single and batched).
+ *
+ * Usage: benchmark_se2 [options]
+ *   --count <n>             poses / points per pass (default 1000)
+ *   --passes <n>            passes per operation (default 1000)
+ */
+
+#include "../include/SE2.h"
+
+#include <tf2/LinearMath/Quaternion.h>
+#include <tf2/LinearMath/Transform.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace neo_local_planner;
+
+
+static volatile double g_sink = 0;
+
+static tf2::Transform to_tf2(const SE2& pose)
+{
+	tf2::Quaternion rotation;
+	rotation.setRPY(0, 0, pose.yaw());
+	return tf2::Transform(rotation, tf2::Vector3(pose.x(), pose.y(), 0));
+}
+
+// best of all passes, in ns per element
+static double measure(int num_passes, size_t count, const std::function<void()>& pass)
+{
+	double best = 1e9;
+	for(int i = 0; i < num_passes; ++i)
+	{
+		const auto time_begin = std::chrono::steady_clock::now();
+		pass();
+		best = std::min(best, std::chrono::duration<double>(std::chrono::steady_clock::now() - time_begin).count());
+	}
+	return best / count * 1e9;
+}
+
+int main(int argc, char** argv)
+{
+	size_t count = 1000;
+	int num_passes = 1000;
+
+	for(int i = 1; i < argc; ++i)
+	{
+		const std::string arg = argv[i];
+		const bool have_value = i + 1 < argc;
+		if(arg == "--count" && have_value) {
+			count = std::max(atoi(argv[++i]), 1);
+		} else if(arg == "--passes" && have_value) {
+			num_passes = std::max(atoi(argv[++i]), 1);
+		} else {
+			fprintf(stderr, "Usage: %s [--count <n>] [--passes <n>]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	std::mt19937 generator(1);
+	std::uniform_real_distribution<double> position(-10, 10);
+	std::uniform_real_distribution<double> yaw(-M_PI, M_PI);
+
+	std::vector<SE2> poses;
+	std::vector<tf2::Transform> transforms;
+	std::vector<double> x(count), y(count), out_x(count), out_y(count);
+	std::vector<tf2::Vector3> points(count);
+	for(size_t i = 0; i < count; ++i)
+	{
+		poses.emplace_back(position(generator), position(generator), yaw(generator));
+		transforms.push_back(to_tf2(poses.back()));
+		x[i] = position(generator);
+		y[i] = position(generator);
+		points[i] = tf2::Vector3(x[i], y[i], 0);
+	}
+	const SE2 pose = poses.front();
+	const tf2::Transform transform = transforms.front();
+
+	printf("operation, se2_ns, tf2_ns, speedup\n");
+	const auto report = [](const char* name, double se2_ns, double tf2_ns) {
+		printf("%s, %.2f, %.2f, %.1f\n", name, se2_ns, tf2_ns, tf2_ns / se2_ns);
+	};
+
+	report("compose",
+		measure(num_passes, count, [&poses]() {
+			SE2 result;
+			for(const SE2& step : poses) {
+				result = result * step;
+			}
+			g_sink = result.x();
+		}),
+		measure(num_passes, count, [&transforms]() {
+			tf2::Transform result = tf2::Transform::getIdentity();
+			for(const tf2::Transform& step : transforms) {
+				result = result * step;
+			}
+			g_sink = result.getOrigin().x();
+		}));
+
+	report("inverse",
+		measure(num_passes, count, [&poses]() {
+			double sum = 0;
+			for(const SE2& entry : poses) {
+				sum += entry.inverse().x();
+			}
+			g_sink = sum;
+		}),
+		measure(num_passes, count, [&transforms]() {
+			double sum = 0;
+			for(const tf2::Transform& entry : transforms) {
+				sum += entry.inverse().getOrigin().x();
+			}
+			g_sink = sum;
+		}));
+
+	report("transform_point",
+		measure(num_passes, count, [&pose, &x, &y]() {
+			double sum = 0;
+			for(size_t i = 0; i < x.size(); ++i) {
+				sum += (pose * point2_t(x[i], y[i])).x;
+			}
+			g_sink = sum;
+		}),
+		measure(num_passes, count, [&transform, &points]() {
+			double sum = 0;
+			for(const tf2::Vector3& point : points) {
+				sum += (transform * point).x();
+			}
+			g_sink = sum;
+		}));
+
+	report("inverse_transform_point",
+		measure(num_passes, count, [&pose, &x, &y]() {
+			double sum = 0;
+			for(size_t i = 0; i < x.size(); ++i) {
+				sum += pose.inverseTransform(point2_t(x[i], y[i])).x;
+			}
+			g_sink = sum;
+		}),
+		measure(num_passes, count, [&transform, &points]() {
+			// like the old code, which inverted once per call
+			double sum = 0;
+			for(const tf2::Vector3& point : points) {
+				sum += (transform.inverse() * point).x();
+			}
+			g_sink = sum;
+		}));
+
+	report("transform_batch",
+		measure(num_passes, count, [&pose, &x, &y, &out_x, &out_y]() {
+			pose.transform(x.data(), y.data(), out_x.data(), out_y.data(), x.size());
+			g_sink = out_x.back();
+		}),
+		measure(num_passes, count, [&transform, &points, &out_x, &out_y]() {
+			for(size_t i = 0; i < points.size(); ++i) {
+				const tf2::Vector3 result = transform * points[i];
+				out_x[i] = result.x();
+				out_y[i] = result.y();
+			}
+			g_sink = out_x.back();
+		}));
+	return 0;
+}
@@ -0,0 +1,198 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2016, Neobotix GmbH
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Neobotix nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+#ifndef TEST_PLANNER_TEST_UTILS_H_
+#define TEST_PLANNER_TEST_UTILS_H_
+
+#include "../include/NeoLocalPlanner.h"
+
+#include <nav2_costmap_2d/costmap_2d.hpp>
+#include <rclcpp_lifecycle/lifecycle_node.hpp>
+#include <tf2/LinearMath/Quaternion.h>
+#include <tf2_geometry_msgs/tf2_geometry_msgs.h>
+
+#include <cmath>
+#include <map>
+#include <memory>
+#include <random>
+#include <string>
+
+
+namespace neo_local_planner {
+namespace test {
+
+/*
+ * Node, transforms and costmap for driving planners in tests and benchmarks, without a navigation stack.
+ * Map and odom coincide, all planners created here share the costmap. Needs rclcpp::init().
+ */
+class PlannerEnvironment {
+public:
+	typedef std::map<std::string, rclcpp::ParameterValue> params_t;
+
+	PlannerEnvironment(	const std::string& node_name, double size_x, double size_y,
+						double resolution, double origin_x, double origin_y)
+	{
+		m_node = std::make_shared<rclcpp_lifecycle::LifecycleNode>(node_name);
+		m_tf = std::make_shared<tf2_ros::Buffer>(m_node->get_clock());
+
+		geometry_msgs::msg::TransformStamped transform;
+		transform.header.stamp = m_node->get_clock()->now();
+		transform.header.frame_id = "map";
+		transform.child_frame_id = "odom";
+		transform.transform.rotation.w = 1;
+		m_tf->setTransform(transform, "test", true);
+
+		m_costmap = std::make_shared<nav2_costmap_2d::Costmap2D>(
+				(unsigned int)(std::ceil(size_x / resolution)), (unsigned int)(std::ceil(size_y / resolution)),
+				resolution, origin_x, origin_y, nav2_costmap_2d::FREE_SPACE);
+	}
+
+	const rclcpp_lifecycle::LifecycleNode::SharedPtr& getNode() const { return m_node; }
+
+	nav2_costmap_2d::Costmap2D& getCostmap() { return *m_costmap; }
+
+	/*
+	 * Configured and activated planner, params are without the plugin name prefix.
+	 */
+	std::shared_ptr<NeoLocalPlanner> createPlanner(const std::string& name, const params_t& params = params_t(),
+													const nav2_costmap_2d::Footprint& footprint = nav2_costmap_2d::Footprint())
+	{
+		for(const auto& entry : params) {
+			m_node->declare_parameter(name + "." + entry.first, entry.second);
+		}
+		auto planner = std::make_shared<NeoLocalPlanner>();
+		planner->configure(m_node, name, m_tf, m_costmap.get(), "base_link", footprint);
+		planner->activate();
+		return planner;
+	}
+
+	/*
+	 * Marks the box lethal, with a ring of inscribed cost around it.
+	 */
+	void addBox(double x0, double y0, double x1, double y1)
+	{
+		const double margin = 2 * m_costmap->getResolution();
+		for(double y = y0 - margin; y <= y1 + margin; y += m_costmap->getResolution()) {
+			for(double x = x0 - margin; x <= x1 + margin; x += m_costmap->getResolution())
+			{
+				unsigned int cell_x = 0;
+				unsigned int cell_y = 0;
+				if(m_costmap->worldToMap(x, y, cell_x, cell_y))
+				{
+					const bool is_inside = x >= x0 && x <= x1 && y >= y0 && y <= y1;
+					const unsigned char cost = is_inside ? nav2_costmap_2d::LETHAL_OBSTACLE : nav2_costmap_2d::INSCRIBED_INFLATED_OBSTACLE;
+					m_costmap->setCost(cell_x, cell_y, std::max(cost, m_costmap->getCost(cell_x, cell_y)));
+				}
+			}
+		}
+	}
+
+	/*
+	 * Scatters single cell obstacles, density is the fraction of cells hit.
+	 */
+	void addRandomObstacles(double density, unsigned int seed)
+	{
+		std::mt19937 generator(seed);
+		std::uniform_real_distribution<double> uniform(0, 1);
+		for(unsigned int y = 0; y < m_costmap->getSizeInCellsY(); ++y) {
+			for(unsigned int x = 0; x < m_costmap->getSizeInCellsX(); ++x) {
+				if(uniform(generator) < density) {
+					m_costmap->setCost(x, y, nav2_costmap_2d::LETHAL_OBSTACLE);
+				}
+			}
+		}
+	}
+
+	/*
+	 * Straight plan in map frame, one pose every step meters.
+	 */
+	nav_msgs::msg::Path makeStraightPlan(double x, double y, double yaw, double length, double step) const
+	{
+		nav_msgs::msg::Path path;
+		path.header.stamp = m_node->get_clock()->now();
+		path.header.frame_id = "map";
+
+		const size_t num_poses = size_t(length / step) + 1;
+		path.poses.resize(num_poses);
+		for(size_t i = 0; i < num_poses; ++i)
+		{
+			path.poses[i].header = path.header;
+			path.poses[i].pose.position.x = x + cos(yaw) * step * i;
+			path.poses[i].pose.position.y = y + sin(yaw) * step * i;
+			path.poses[i].pose.orientation = yaw_to_msg(yaw);
+		}
+		return path;
+	}
+
+	nav_msgs::msg::Odometry::SharedPtr makeOdom(double x, double y, double yaw, double vel_x, double yawrate) const
+	{
+		auto odom = std::make_shared<nav_msgs::msg::Odometry>();
+		odom->header.stamp = m_node->get_clock()->now();
+		odom->header.frame_id = "odom";
+		odom->child_frame_id = "base_link";
+		odom->pose.pose.position.x = x;
+		odom->pose.pose.position.y = y;
+		odom->pose.pose.orientation = yaw_to_msg(yaw);
+		odom->twist.twist.linear.x = vel_x;
+		odom->twist.twist.angular.z = yawrate;
+		return odom;
+	}
+
+	static geometry_msgs::msg::PoseStamped toPose(const nav_msgs::msg::Odometry& odom)
+	{
+		geometry_msgs::msg::PoseStamped pose;
+		pose.header = odom.header;
+		pose.pose = odom.pose.pose;
+		return pose;
+	}
+
+	static geometry_msgs::msg::Quaternion yaw_to_msg(double yaw)
+	{
+		tf2::Quaternion q;
+		q.setRPY(0, 0, yaw);
+		return tf2::toMsg(q);
+	}
+
+private:
+	rclcpp_lifecycle::LifecycleNode::SharedPtr m_node;
+	std::shared_ptr<tf2_ros::Buffer> m_tf;
+	std::shared_ptr<nav2_costmap_2d::Costmap2D> m_costmap;
+
+};
+
+
+} // test
+} // neo_local_planner
+
+#endif /* TEST_PLANNER_TEST_UTILS_H_ */
@@ -0,0 +1,454 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2016, Neobotix GmbH
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Neobotix nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+/*
+ * Scaling benchmark suite, registered with CTest.
+ * Sweeps plan length, costmap resolution, costmap size and obstacle density, measures setPlan() time and
+ * memory and computeVelocityCommands() time, and fits the exponent of each against the swept variable
+ * (slope in log-log space). Exponents do not depend on the machine, so the checked in baseline holds
+ * those, next to the points they were fitted to: the run fails if a measured exponent exceeds its baseline
+ * plus tolerance, e.g. when a linear term turns quadratic or a constant one starts growing with plan length.
+ *
+ * Usage: scaling_suite [options]
+ *   --baseline <file>       baseline JSON to check against (required)
+ *   --output <file>         write all measurements and exponents as JSON (default scaling_results.json)
+ *   --update-baseline       write the measured exponents and points into the baseline file instead of checking,
+ *                           tolerances already in the file are kept
+ *   --quick                 fewer points and cycles, for a smoke test
+ */
+
+#include "planner_test_utils.h"
+
+#include <malloc.h>
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace neo_local_planner;
+
+
+struct point_t {
+	double x = 0;						// swept variable
+	double set_plan_time = 0;			// [s]
+	double set_plan_memory = 0;			// heap bytes kept by the planner after setPlan()
+	double cycle_time = 0;				// median [s]
+};
+
+struct check_t {
+	std::string sweep;
+	std::string metric;
+	double slope = 0;					// measured
+	double baseline = 0;
+	double tolerance = 0;
+	bool have_baseline = false;
+};
+
+struct sweep_config_t {
+	double plan_length = 100;			// [poses]
+	double resolution = 0.05;			// [m]
+	double map_size = 20;				// [m]
+	double density = 0.001;				// share of lethal cells
+};
+
+static const double plan_step = 0.05;	// [m]
+
+static size_t heap_in_use()
+{
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+	return mallinfo2().uordblks;
+#else
+	return size_t(mallinfo().uordblks);
+#endif
+}
+
+static double fit_slope(const std::vector<point_t>& points, double point_t::*metric)
+{
+	double sum_x = 0, sum_y = 0, sum_xx = 0, sum_xy = 0;
+	int count = 0;
+	for(const auto& point : points)
+	{
+		const double value = point.*metric;
+		if(value <= 0) {
+			continue;
+		}
+		const double x = log(point.x);
+		const double y = log(value);
+		sum_x += x;
+		sum_y += y;
+		sum_xx += x * x;
+		sum_xy += x * y;
+		count++;
+	}
+	const double denom = count * sum_xx - sum_x * sum_x;
+	return count >= 2 && denom > 0 ? (count * sum_xy - sum_x * sum_y) / denom : 0;
+}
+
+static point_t measure(const sweep_config_t& config, double x, int num_cycles, int index)
+{
+	point_t point;
+	point.x = x;
+
+	const double size = config.map_size;
+	test::PlannerEnvironment env("scaling_suite_" + std::to_string(index), size, size, config.resolution, -size / 4, -size / 2);
+	env.addRandomObstacles(config.density, 1);
+
+	// straight plan from the robot, longer plans leave the map far beyond the scan horizon
+	const auto plan = env.makeStraightPlan(0, 0, 0, (config.plan_length - 1) * plan_step, plan_step);
+
+	test::PlannerEnvironment::params_t params;
+	params["flight_recorder_size"] = rclcpp::ParameterValue(0);
+	auto planner = env.createPlanner("FollowPath", params);
+	{
+		const size_t heap_begin = heap_in_use();
+		const auto time_begin = std::chrono::steady_clock::now();
+		planner->setPlan(plan);
+		point.set_plan_time = std::chrono::duration<double>(std::chrono::steady_clock::now() - time_begin).count();
+		point.set_plan_memory = double(heap_in_use()) - double(heap_begin);
+	}
+
+	const double dt = 0.05;
+	double pose[3] = {};
+	std::vector<double> times;
+	for(int k = 0; k < num_cycles + 5; ++k)
+	{
+		const auto odom = env.makeOdom(pose[0], pose[1], pose[2], 0, 0);
+		planner->odomCallback(odom);
+
+		const auto time_begin = std::chrono::steady_clock::now();
+		const auto cmd_vel = planner->computeVelocityCommands(test::PlannerEnvironment::toPose(*odom), odom->twist.twist);
+		if(k >= 5) {
+			times.push_back(std::chrono::duration<double>(std::chrono::steady_clock::now() - time_begin).count());
+		}
+		const double yaw = pose[2] + cmd_vel.twist.angular.z * dt / 2;
+		pose[0] += cmd_vel.twist.linear.x * cos(yaw) * dt;
+		pose[1] += cmd_vel.twist.linear.x * sin(yaw) * dt;
+		pose[2] += cmd_vel.twist.angular.z * dt;
+	}
+	std::sort(times.begin(), times.end());
+	point.cycle_time = times[times.size() / 2];
+
+	planner->deactivate();
+	planner->cleanup();
+	return point;
+}
+
+/*
+ * Reads the numbers of a JSON document into a flat map, nested keys joined by '.'.
+ * Just enough for the baseline file, array elements are keyed by their index.
+ */
+class JsonReader {
+public:
+	explicit JsonReader(const std::string& text) : m_text(text) {}
+
+	bool parse(std::map<std::string, double>& values)
+	{
+		skipSpace();
+		return parseValue("", values) && (skipSpace(), m_pos == m_text.size());
+	}
+
+private:
+	void skipSpace()
+	{
+		while(m_pos < m_text.size() && isspace((unsigned char)m_text[m_pos])) {
+			m_pos++;
+		}
+	}
+
+	bool parseString(std::string& out)
+	{
+		if(m_pos >= m_text.size() || m_text[m_pos] != '"') {
+			return false;
+		}
+		const size_t end = m_text.find('"', m_pos + 1);
+		if(end == std::string::npos) {
+			return false;
+		}
+		out = m_text.substr(m_pos + 1, end - m_pos - 1);
+		m_pos = end + 1;
+		return true;
+	}
+
+	bool parseValue(const std::string& key, std::map<std::string, double>& values)
+	{
+		skipSpace();
+		if(m_pos >= m_text.size()) {
+			return false;
+		}
+		const char c = m_text[m_pos];
+		if(c == '{' || c == '[')
+		{
+			const char close = c == '{' ? '}' : ']';
+			m_pos++;
+			skipSpace();
+			for(int i = 0; m_pos < m_text.size() && m_text[m_pos] != close; ++i)
+			{
+				std::string name = std::to_string(i);
+				if(c == '{') {
+					if(!parseString(name)) {
+						return false;
+					}
+					skipSpace();
+					if(m_pos >= m_text.size() || m_text[m_pos++] != ':') {
+						return false;
+					}
+				}
+				if(!parseValue(key.empty() ? name : key + "." + name, values)) {
+					return false;
+				}
+				skipSpace();
+				if(m_pos < m_text.size() && m_text[m_pos] == ',') {
+					m_pos++;
+					skipSpace();
+				}
+			}
+			return m_pos++ < m_text.size();
+		}
+		if(c == '"') {
+			std::string dummy;
+			return parseString(dummy);
+		}
+		if(m_text.compare(m_pos, 4, "true") == 0 || m_text.compare(m_pos, 4, "null") == 0) {
+			m_pos += 4;
+			return true;
+		}
+		if(m_text.compare(m_pos, 5, "false") == 0) {
+			m_pos += 5;
+			return true;
+		}
+		size_t length = 0;
+		try {
+			values[key] = std::stod(m_text.substr(m_pos, 32), &length);
+		} catch(...) {
+			return false;
+		}
+		m_pos += length;
+		return true;
+	}
+
+	const std::string& m_text;
+	size_t m_pos = 0;
+
+};
+
+static void write_sweeps(std::ostream& out, const std::map<std::string, std::vector<point_t>>& sweeps)
+{
+	out << "  \"sweeps\": {\n";
+	for(auto iter = sweeps.begin(); iter != sweeps.end(); ++iter)
+	{
+		out << "    \"" << iter->first << "\": [\n";
+		for(size_t i = 0; i < iter->second.size(); ++i)
+		{
+			const point_t& point = iter->second[i];
+			out << "      {\"x\": " << point.x << ", \"set_plan_time\": " << point.set_plan_time
+				<< ", \"set_plan_memory\": " << point.set_plan_memory << ", \"cycle_time\": " << point.cycle_time
+				<< "}" << (i + 1 < iter->second.size() ? "," : "") << "\n";
+		}
+		out << "    ]" << (std::next(iter) != sweeps.end() ? "," : "") << "\n";
+	}
+	out << "  }";
+}
+
+static void write_results(	const std::string& file_name, const std::map<std::string, std::vector<point_t>>& sweeps,
+							const std::vector<check_t>& checks)
+{
+	std::ofstream out(file_name);
+	out << "{\n";
+	write_sweeps(out, sweeps);
+	out << ",\n  \"slopes\": {\n";
+	for(size_t i = 0; i < checks.size(); ++i) {
+		out << "    \"" << checks[i].sweep << "/" << checks[i].metric << "\": " << checks[i].slope
+			<< (i + 1 < checks.size() ? "," : "") << "\n";
+	}
+	out << "  }\n}\n";
+}
+
+/*
+ * Exponents with their tolerance, followed by the measurements they were fitted to,
+ * so a reviewer can see what the tolerances were chosen against.
+ */
+static void write_baseline(	const std::string& file_name, const std::map<std::string, std::vector<point_t>>& sweeps,
+							const std::vector<check_t>& checks)
+{
+	std::ofstream out(file_name);
+	out << "{\n  \"checks\": {\n";
+	for(size_t i = 0; i < checks.size(); ++i)
+	{
+		const check_t& check = checks[i];
+		out << "    \"" << check.sweep << "/" << check.metric << "\": {\"slope\": "
+			<< std::round(check.slope * 100) / 100 << ", \"tolerance\": " << check.tolerance << "}"
+			<< (i + 1 < checks.size() ? "," : "") << "\n";
+	}
+	out << "  },\n";
+	write_sweeps(out, sweeps);
+	out << "\n}\n";
+}
+
+int main(int argc, char** argv)
+{
+	std::string baseline_file;
+	std::string output_file = "scaling_results.json";
+	bool update_baseline = false;
+	bool quick = false;
+
+	for(int i = 1; i < argc; ++i)
+	{
+		const std::string arg = argv[i];
+		const bool have_value = i + 1 < argc;
+		if(arg == "--baseline" && have_value) {
+			baseline_file = argv[++i];
+		} else if(arg == "--output" && have_value) {
+			output_file = argv[++i];
+		} else if(arg == "--update-baseline") {
+			update_baseline = true;
+		} else if(arg == "--quick") {
+			quick = true;
+		} else {
+			baseline_file.clear();
+			break;
+		}
+	}
+	if(baseline_file.empty()) {
+		fprintf(stderr, "Usage: %s --baseline <file> [--output <file>] [--update-baseline] [--quick]\n", argv[0]);
+		return 1;
+	}
+
+	std::map<std::string, double> baseline;
+	{
+		std::ifstream in(baseline_file);
+		std::stringstream text;
+		text << in.rdbuf();
+		// when updating, an unreadable baseline only means the default tolerances are used
+		if(!JsonReader(text.str()).parse(baseline) && !update_baseline) {
+			fprintf(stderr, "Failed to read baseline %s\n", baseline_file.c_str());
+			return 1;
+		}
+	}
+
+	rclcpp::init(argc, argv);
+	const int num_cycles = quick ? 10 : 50;
+
+	std::map<std::string, std::vector<point_t>> sweeps;
+	int index = 0;
+	{
+		const std::vector<double> lengths = quick ? std::vector<double>{100, 1e4, 1e6}
+												: std::vector<double>{100, 1e3, 1e4, 1e5, 1e6};
+		for(const double length : lengths) {
+			sweep_config_t config;
+			config.plan_length = length;
+			sweeps["plan_length"].push_back(measure(config, length, num_cycles, index++));
+		}
+	}
+	for(const double resolution : {0.1, 0.05, 0.025})
+	{
+		// swept variable is cells per meter
+		sweep_config_t config;
+		config.resolution = resolution;
+		sweeps["resolution"].push_back(measure(config, 1 / resolution, num_cycles, index++));
+	}
+	for(const double size : {10., 20., 40., 80.})
+	{
+		sweep_config_t config;
+		config.map_size = size;
+		sweeps["map_size"].push_back(measure(config, size, num_cycles, index++));
+	}
+	for(const double density : {1e-4, 1e-3, 1e-2})
+	{
+		sweep_config_t config;
+		config.density = density;
+		sweeps["density"].push_back(measure(config, density, num_cycles, index++));
+	}
+	rclcpp::shutdown();
+
+	// what to check, tolerance used when writing a new baseline
+	const struct {
+		const char* sweep;
+		const char* metric;
+		double point_t::*member;
+		double tolerance;
+	} metrics[] = {
+		{"plan_length", "set_plan_time", &point_t::set_plan_time, 0.3},
+		{"plan_length", "set_plan_memory", &point_t::set_plan_memory, 0.2},
+		{"plan_length", "cycle_time", &point_t::cycle_time, 0.2},
+		{"resolution", "cycle_time", &point_t::cycle_time, 0.5},
+		{"map_size", "cycle_time", &point_t::cycle_time, 0.5},
+		{"density", "cycle_time", &point_t::cycle_time, 0.3},
+	};
+
+	std::vector<check_t> checks;
+	bool is_ok = true;
+	for(const auto& metric : metrics)
+	{
+		check_t check;
+		check.sweep = metric.sweep;
+		check.metric = metric.metric;
+		check.slope = fit_slope(sweeps[check.sweep], metric.member);
+		check.tolerance = metric.tolerance;
+
+		const std::string key = "checks." + check.sweep + "/" + check.metric;
+		if(baseline.count(key + ".slope") && baseline.count(key + ".tolerance"))
+		{
+			check.have_baseline = true;
+			check.baseline = baseline[key + ".slope"];
+			check.tolerance = baseline[key + ".tolerance"];
+		}
+		const bool is_regression = check.have_baseline && !update_baseline && check.slope > check.baseline + check.tolerance;
+		if(!update_baseline && (!check.have_baseline || is_regression)) {
+			is_ok = false;
+		}
+		printf("%-12s %-16s exponent %6.2f", metric.sweep, metric.metric, check.slope);
+		if(check.have_baseline && !update_baseline) {
+			printf(" (baseline %.2f + %.2f)%s\n", check.baseline, check.tolerance, is_regression ? " REGRESSION" : "");
+		} else {
+			printf(update_baseline ? "\n" : " (no baseline)\n");
+		}
+		checks.push_back(check);
+	}
+
+	write_results(output_file, sweeps, checks);
+	if(update_baseline) {
+		write_baseline(baseline_file, sweeps, checks);
+		printf("Updated %s\n", baseline_file.c_str());
+		return 0;
+	}
+	return is_ok ? 0 : 1;
+}
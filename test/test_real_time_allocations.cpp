@@ -0,0 +1,226 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2016, Neobotix GmbH
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Neobotix nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+/*
+ * Runs full control cycles in real_time_mode and fails on any heap allocation made by the control thread.
+ * The global operator new replacements below are part of this executable, so they also catch
+ * allocations inside the planner library and its dependencies.
+ */
+
+#include "planner_test_utils.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <memory>
+#include <new>
+#include <utility>
+#include <thread>
+
+using namespace neo_local_planner;
+
+
+static std::atomic<uint64_t> g_num_allocations {0};
+static thread_local bool g_is_counting = false;
+
+static void* counted_malloc(std::size_t size)
+{
+	if(g_is_counting) {
+		g_num_allocations++;
+	}
+	return std::malloc(size > 0 ? size : 1);
+}
+
+static void* counted_aligned_alloc(std::size_t size, std::size_t alignment)
+{
+	if(g_is_counting) {
+		g_num_allocations++;
+	}
+	void* ptr = 0;
+	return ::posix_memalign(&ptr, alignment, size > 0 ? size : 1) == 0 ? ptr : nullptr;
+}
+
+void* operator new(std::size_t size)
+{
+	void* ptr = counted_malloc(size);
+	if(!ptr) {
+		throw std::bad_alloc();
+	}
+	return ptr;
+}
+
+void* operator new[](std::size_t size)
+{
+	return operator new(size);
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept
+{
+	return counted_malloc(size);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept
+{
+	return counted_malloc(size);
+}
+
+void operator delete(void* ptr) noexcept { std::free(ptr); }
+void operator delete[](void* ptr) noexcept { std::free(ptr); }
+void operator delete(void* ptr, std::size_t) noexcept { std::free(ptr); }
+void operator delete[](void* ptr, std::size_t) noexcept { std::free(ptr); }
+void operator delete(void* ptr, const std::nothrow_t&) noexcept { std::free(ptr); }
+void operator delete[](void* ptr, const std::nothrow_t&) noexcept { std::free(ptr); }
+
+#ifdef __cpp_aligned_new
+
+void* operator new(std::size_t size, std::align_val_t alignment)
+{
+	void* ptr = counted_aligned_alloc(size, std::max(std::size_t(alignment), sizeof(void*)));
+	if(!ptr) {
+		throw std::bad_alloc();
+	}
+	return ptr;
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment)
+{
+	return operator new(size, alignment);
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+	return counted_aligned_alloc(size, std::max(std::size_t(alignment), sizeof(void*)));
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+	return counted_aligned_alloc(size, std::max(std::size_t(alignment), sizeof(void*)));
+}
+
+void operator delete(void* ptr, std::align_val_t) noexcept { std::free(ptr); }
+void operator delete[](void* ptr, std::align_val_t) noexcept { std::free(ptr); }
+void operator delete(void* ptr, std::size_t, std::align_val_t) noexcept { std::free(ptr); }
+void operator delete[](void* ptr, std::size_t, std::align_val_t) noexcept { std::free(ptr); }
+void operator delete(void* ptr, std::align_val_t, const std::nothrow_t&) noexcept { std::free(ptr); }
+void operator delete[](void* ptr, std::align_val_t, const std::nothrow_t&) noexcept { std::free(ptr); }
+
+#endif
+
+/*
+ * Drives one planner along a straight lane with an obstacle next to it,
+ * counting allocations made by computeVelocityCommands() only.
+ */
+static uint64_t count_cycle_allocations(const test::PlannerEnvironment::params_t& params, int num_warmup, int num_cycles,
+										const nav2_costmap_2d::Footprint& footprint = nav2_costmap_2d::Footprint())
+{
+	test::PlannerEnvironment env("test_real_time_allocations", 12, 4, 0.05, -1, -2);
+	env.addBox(4, 0.6, 4.5, 1.5);
+
+	auto planner = env.createPlanner("FollowPath", params, footprint);
+	planner->setPlan(env.makeStraightPlan(0, 0, 0, 8, 0.05));
+
+	const double dt = 0.05;
+	double pose[3] = {};
+	uint64_t num_allocations = 0;
+
+	for(int k = 0; k < num_warmup + num_cycles; ++k)
+	{
+		// messages are built outside of the counted region, like the controller server does
+		const auto odom = env.makeOdom(pose[0], pose[1], pose[2], 0, 0);
+		const auto position = test::PlannerEnvironment::toPose(*odom);
+		planner->odomCallback(odom);
+
+		const uint64_t count_begin = g_num_allocations;
+		g_is_counting = k >= num_warmup;
+		const auto cmd_vel = planner->computeVelocityCommands(position, odom->twist.twist);
+		g_is_counting = false;
+		num_allocations += g_num_allocations - count_begin;
+
+		const double yaw = pose[2] + cmd_vel.twist.angular.z * dt / 2;
+		pose[0] += cmd_vel.twist.linear.x * cos(yaw) * dt;
+		pose[1] += cmd_vel.twist.linear.x * sin(yaw) * dt;
+		pose[2] += cmd_vel.twist.angular.z * dt;
+
+		// give the support task time to publish
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	planner->deactivate();
+	planner->cleanup();
+	return num_allocations;
+}
+
+TEST(RealTimeMode, CounterSeesAllocations)
+{
+	g_is_counting = true;
+	const uint64_t count_begin = g_num_allocations;
+	std::unique_ptr<int> value(new int(1));
+	g_is_counting = false;
+	EXPECT_EQ(g_num_allocations - count_begin, 1u);
+}
+
+TEST(RealTimeMode, NoAllocationsInControlCycle)
+{
+	test::PlannerEnvironment::params_t params;
+	params["real_time_mode"] = rclcpp::ParameterValue(true);
+	EXPECT_EQ(count_cycle_allocations(params, 50, 200), 0u);
+}
+
+TEST(RealTimeMode, NoAllocationsWithSpeedLimitMap)
+{
+	test::PlannerEnvironment::params_t params;
+	params["real_time_mode"] = rclcpp::ParameterValue(true);
+	params["speed_map_dist"] = rclcpp::ParameterValue(2.0);
+
+	nav2_costmap_2d::Footprint footprint;
+	for(const auto& corner : {std::make_pair(0.4, 0.3), {0.4, -0.3}, {-0.4, -0.3}, {-0.4, 0.3}})
+	{
+		geometry_msgs::msg::Point point;
+		point.x = corner.first;
+		point.y = corner.second;
+		footprint.push_back(point);
+	}
+	EXPECT_EQ(count_cycle_allocations(params, 50, 200, footprint), 0u);
+}
+
+int main(int argc, char** argv)
+{
+	testing::InitGoogleTest(&argc, argv);
+	rclcpp::init(argc, argv);
+	const int result = RUN_ALL_TESTS();
+	rclcpp::shutdown();
+	return result;
+}
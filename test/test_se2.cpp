@@ -0,0 +1,179 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2016, Neobotix GmbH
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Neobotix nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+#include "../include/SE2.h"
+
+#include <tf2/LinearMath/Quaternion.h>
+#include <tf2/LinearMath/Transform.h>
+#include <tf2/utils.h>
+
+#include <gtest/gtest.h>
+
+#include <random>
+#include <vector>
+
+using namespace neo_local_planner;
+
+
+static const double tolerance = 1e-9;
+
+static tf2::Transform to_tf2(const SE2& pose)
+{
+	tf2::Quaternion rotation;
+	rotation.setRPY(0, 0, pose.yaw());
+	return tf2::Transform(rotation, tf2::Vector3(pose.x(), pose.y(), 0));
+}
+
+static void expect_near(const SE2& pose, const tf2::Transform& expected)
+{
+	EXPECT_NEAR(pose.x(), expected.getOrigin().x(), tolerance);
+	EXPECT_NEAR(pose.y(), expected.getOrigin().y(), tolerance);
+	EXPECT_NEAR(normalize_yaw(pose.yaw() - tf2::getYaw(expected.getRotation())), 0, tolerance);
+	EXPECT_NEAR(pose.cosYaw(), cos(pose.yaw()), tolerance);
+	EXPECT_NEAR(pose.sinYaw(), sin(pose.yaw()), tolerance);
+}
+
+// yaw goes past one turn on purpose, SE2 has to normalize it
+static std::vector<SE2> random_poses(size_t count, unsigned seed)
+{
+	std::mt19937 generator(seed);
+	std::uniform_real_distribution<double> position(-50, 50);
+	std::uniform_real_distribution<double> yaw(-3 * M_PI, 3 * M_PI);
+
+	std::vector<SE2> poses;
+	for(size_t i = 0; i < count; ++i) {
+		poses.emplace_back(position(generator), position(generator), yaw(generator));
+	}
+	return poses;
+}
+
+
+TEST(SE2, ConstructorNormalizesYaw)
+{
+	for(const SE2& pose : random_poses(1000, 1))
+	{
+		EXPECT_LE(pose.yaw(), M_PI);
+		EXPECT_GE(pose.yaw(), -M_PI);
+		expect_near(pose, to_tf2(pose));
+	}
+}
+
+TEST(SE2, ComposeMatchesTf2)
+{
+	const std::vector<SE2> poses = random_poses(1000, 2);
+	for(size_t i = 0; i + 1 < poses.size(); ++i)
+	{
+		const SE2 result = poses[i] * poses[i + 1];
+		EXPECT_LE(result.yaw(), M_PI);
+		EXPECT_GE(result.yaw(), -M_PI);
+		expect_near(result, to_tf2(poses[i]) * to_tf2(poses[i + 1]));
+	}
+}
+
+TEST(SE2, ComposeChainMatchesTf2)
+{
+	// error must not build up over a chain as long as a plan
+	SE2 result;
+	tf2::Transform expected = tf2::Transform::getIdentity();
+	for(const SE2& step : random_poses(1000, 3))
+	{
+		const SE2 small_step(step.x() * 0.01, step.y() * 0.01, step.yaw());
+		result = result * small_step;
+		expected = expected * to_tf2(small_step);
+	}
+	EXPECT_NEAR(result.x(), expected.getOrigin().x(), 1e-6);
+	EXPECT_NEAR(result.y(), expected.getOrigin().y(), 1e-6);
+	EXPECT_NEAR(normalize_yaw(result.yaw() - tf2::getYaw(expected.getRotation())), 0, 1e-6);
+}
+
+TEST(SE2, InverseMatchesTf2)
+{
+	for(const SE2& pose : random_poses(1000, 4))
+	{
+		expect_near(pose.inverse(), to_tf2(pose).inverse());
+		expect_near(pose * pose.inverse(), tf2::Transform::getIdentity());
+	}
+}
+
+TEST(SE2, TransformPointMatchesTf2)
+{
+	const std::vector<SE2> poses = random_poses(1000, 5);
+	for(size_t i = 0; i + 1 < poses.size(); ++i)
+	{
+		const point2_t point = poses[i + 1].position();
+		const tf2::Vector3 expected = to_tf2(poses[i]) * tf2::Vector3(point.x, point.y, 0);
+		const point2_t result = poses[i] * point;
+		EXPECT_NEAR(result.x, expected.x(), tolerance);
+		EXPECT_NEAR(result.y, expected.y(), tolerance);
+	}
+}
+
+TEST(SE2, InverseTransformMatchesTf2)
+{
+	const std::vector<SE2> poses = random_poses(1000, 6);
+	for(size_t i = 0; i + 1 < poses.size(); ++i)
+	{
+		const point2_t point = poses[i + 1].position();
+		const tf2::Vector3 expected = to_tf2(poses[i]).inverse() * tf2::Vector3(point.x, point.y, 0);
+		const point2_t result = poses[i].inverseTransform(point);
+		EXPECT_NEAR(result.x, expected.x(), tolerance);
+		EXPECT_NEAR(result.y, expected.y(), tolerance);
+	}
+}
+
+TEST(SE2, BatchTransformMatchesTf2)
+{
+	const std::vector<SE2> points = random_poses(1001, 7);
+	const SE2& pose = points.back();
+	std::vector<double> x, y;
+	for(size_t i = 0; i + 1 < points.size(); ++i) {
+		x.push_back(points[i].x());
+		y.push_back(points[i].y());
+	}
+	std::vector<double> out_x(x.size()), out_y(y.size());
+	pose.transform(x.data(), y.data(), out_x.data(), out_y.data(), x.size());
+
+	const tf2::Transform transform = to_tf2(pose);
+	for(size_t i = 0; i < x.size(); ++i)
+	{
+		const tf2::Vector3 expected = transform * tf2::Vector3(x[i], y[i], 0);
+		EXPECT_NEAR(out_x[i], expected.x(), tolerance);
+		EXPECT_NEAR(out_y[i], expected.y(), tolerance);
+	}
+
+	// in place
+	pose.transform(x.data(), y.data(), x.data(), y.data(), x.size());
+	EXPECT_EQ(x, out_x);
+	EXPECT_EQ(y, out_y);
+}
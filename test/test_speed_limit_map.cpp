@@ -0,0 +1,183 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2016, Neobotix GmbH
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Neobotix nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+#include "../include/SpeedLimitMap.h"
+
+#include <gtest/gtest.h>
+
+#include <array>
+#include <cmath>
+#include <random>
+#include <vector>
+
+using namespace neo_local_planner;
+
+
+static nav2_costmap_2d::Footprint make_footprint(const std::vector<std::array<double, 2>>& corners)
+{
+	nav2_costmap_2d::Footprint footprint;
+	for(const auto& corner : corners)
+	{
+		geometry_msgs::msg::Point point;
+		point.x = corner[0];
+		point.y = corner[1];
+		footprint.push_back(point);
+	}
+	return footprint;
+}
+
+// straight plan along x, one pose every 5 cm
+static PlanStorage make_straight_plan(double length)
+{
+	std::vector<plan_point_t> points(size_t(std::round(length / 0.05)) + 1);
+	for(size_t i = 0; i < points.size(); ++i) {
+		points[i].x = i * 0.05;
+	}
+	PlanStorage plan;
+	plan.assign(points);
+	return plan;
+}
+
+static const double all_dirty[4] = {-1e9, -1e9, 1e9, 1e9};
+
+
+TEST(SpeedLimitMap, FootprintCostMatchesCollisionChecker)
+{
+	// lethal, inscribed and unknown cells among random inflation
+	std::mt19937 generator(1);
+	nav2_costmap_2d::Costmap2D costmap(100, 80, 0.05, -2.5, -2, nav2_costmap_2d::FREE_SPACE);
+	for(unsigned int y = 0; y < costmap.getSizeInCellsY(); ++y) {
+		for(unsigned int x = 0; x < costmap.getSizeInCellsX(); ++x)
+		{
+			const unsigned int dice = generator() % 100;
+			costmap.setCost(x, y, dice < 2 ? nav2_costmap_2d::LETHAL_OBSTACLE
+								: dice < 4 ? nav2_costmap_2d::INSCRIBED_INFLATED_OBSTACLE
+								: dice < 5 ? nav2_costmap_2d::NO_INFORMATION : generator() % 200);
+		}
+	}
+	nav2_costmap_2d::FootprintCollisionChecker<nav2_costmap_2d::Costmap2D*> checker(&costmap);
+
+	// poses reach past the map edges, so some corners are off the map
+	std::uniform_real_distribution<double> pos_x(-3, 3);
+	std::uniform_real_distribution<double> pos_y(-2.5, 2.5);
+	std::uniform_real_distribution<double> yaw(-M_PI, M_PI);
+
+	const std::vector<nav2_costmap_2d::Footprint> footprints = {
+		make_footprint({{0.4, 0.3}, {0.4, -0.3}, {-0.4, -0.3}, {-0.4, 0.3}}),
+		make_footprint({{0.5, 0}, {0.2, -0.35}, {-0.3, -0.3}, {-0.45, 0.1}, {-0.1, 0.4}, {0.3, 0.3}, {0.45, 0.2}}),
+		make_footprint({{0.1, 0}, {-0.1, 0}}),
+	};
+	for(const auto& footprint : footprints)
+	{
+		SpeedLimitMap map;
+		map.setFootprint(footprint);
+		int num_off_map = 0;
+		for(int i = 0; i < 10000; ++i)
+		{
+			const double x = pos_x(generator);
+			const double y = pos_y(generator);
+			const double theta = yaw(generator);
+			const double expected = checker.footprintCostAtPose(x, y, theta, footprint) / 255.;
+			ASSERT_EQ(map.computeFootprintCost(&costmap, x, y, theta), expected)
+					<< "x=" << x << " y=" << y << " yaw=" << theta << " corners=" << footprint.size();
+			num_off_map += fabs(x) > 2.3 || fabs(y) > 1.8;
+		}
+		EXPECT_GT(num_off_map, 100);
+	}
+}
+
+TEST(SpeedLimitMap, StopsBeforeBlockedStation)
+{
+	// station centers fall into cell centers, wall across the plan at x = 3 m
+	nav2_costmap_2d::Costmap2D costmap(200, 40, 0.05, -0.025, -1, nav2_costmap_2d::FREE_SPACE);
+	for(unsigned int y = 0; y < costmap.getSizeInCellsY(); ++y) {
+		costmap.setCost(60, y, nav2_costmap_2d::LETHAL_OBSTACLE);
+	}
+	const PlanStorage plan = make_straight_plan(8);
+
+	SpeedLimitMap::params_t params;
+	params.step = 0.1;
+	params.horizon = 5;
+	params.max_vel = 10;
+	params.stop_accel = 0.5;
+	params.stop_margin = 0.4;
+	params.max_cost = 0.9;
+
+	SpeedLimitMap map;
+	map.configure(params);
+	map.update(plan, 0, SE2(), &costmap, all_dirty);
+	ASSERT_TRUE(map.isValid());
+
+	// odd plan indices sit in the middle of station (i - 1) / 2
+	for(size_t i = 1; i < 60; i += 2)
+	{
+		const double dist = 3.0 - (i - 1) / 2 * params.step;
+		const double expected = std::sqrt(2 * params.stop_accel * std::max(dist - params.stop_margin, 0.));
+		EXPECT_NEAR(map.getSpeedLimit(plan, i), expected, 1e-9) << "dist " << dist;
+	}
+	EXPECT_EQ(map.getSpeedLimit(plan, 61), 0);
+	EXPECT_EQ(map.getSpeedLimit(plan, 63), params.max_vel);
+}
+
+TEST(SpeedLimitMap, InflationOnOutlineDoesNotBlock)
+{
+	// corridor walls 0.3 m from the plan, inflated up to the footprint sides
+	nav2_costmap_2d::Costmap2D costmap(200, 40, 0.05, -1.025, -1, nav2_costmap_2d::FREE_SPACE);
+	for(unsigned int x = 0; x < costmap.getSizeInCellsX(); ++x) {
+		for(unsigned int y = 0; y < costmap.getSizeInCellsY(); ++y)
+		{
+			const double dist = 0.3 - std::fabs(-1 + (y + 0.5) * 0.05);
+			costmap.setCost(x, y, dist <= 0 ? nav2_costmap_2d::LETHAL_OBSTACLE
+								: dist < 0.15 ? nav2_costmap_2d::INSCRIBED_INFLATED_OBSTACLE : 240);
+		}
+	}
+	const PlanStorage plan = make_straight_plan(8);
+
+	SpeedLimitMap::params_t params;
+	params.horizon = 5;
+	params.max_vel = 1;
+	params.stop_accel = 0.5;
+	params.max_cost = 0.9;
+
+	SpeedLimitMap map;
+	map.configure(params);
+	map.setFootprint(make_footprint({{0.3, 0.2}, {0.3, -0.2}, {-0.3, -0.2}, {-0.3, 0.2}}));
+	map.update(plan, 0, SE2(), &costmap, all_dirty);
+	EXPECT_EQ(map.getSpeedLimit(plan, 1), params.max_vel);
+
+	// a wider robot touches the walls
+	map.setFootprint(make_footprint({{0.3, 0.35}, {0.3, -0.35}, {-0.3, -0.35}, {-0.3, 0.35}}));
+	map.update(plan, 0, SE2(), &costmap, all_dirty);
+	EXPECT_EQ(map.getSpeedLimit(plan, 1), 0);
+}
@@ -0,0 +1,126 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2016, Neobotix GmbH
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Neobotix nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+#include "../include/ThreadPlacement.h"
+
+#include <gtest/gtest.h>
+
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <unistd.h>
+
+using namespace neo_local_planner;
+
+
+TEST(ThreadPlacement, ParseCpuList)
+{
+	std::vector<int> cpus;
+	std::string error;
+	ASSERT_TRUE(parse_cpu_list("0", cpus, error)) << error;
+	EXPECT_EQ(cpus, std::vector<int>({0}));
+
+	ASSERT_TRUE(parse_cpu_list("", cpus, error)) << error;
+	EXPECT_TRUE(cpus.empty());
+
+	if(::sysconf(_SC_NPROCESSORS_CONF) >= 4)
+	{
+		ASSERT_TRUE(parse_cpu_list("0,2-3,,1", cpus, error)) << error;
+		EXPECT_EQ(cpus, std::vector<int>({0, 2, 3, 1}));
+	}
+}
+
+TEST(ThreadPlacement, ParseCpuListKeepsListOnError)
+{
+	std::vector<int> cpus = {0};
+	std::string error;
+	for(const char* list : {"0,x", "0,1-", "0,3-2", "0,-1", "0,100000"})
+	{
+		EXPECT_FALSE(parse_cpu_list(list, cpus, error)) << list;
+		EXPECT_FALSE(error.empty()) << list;
+		EXPECT_EQ(cpus, std::vector<int>({0})) << list;
+		error.clear();
+	}
+}
+
+TEST(ThreadPlacement, PrefaultStackIsClamped)
+{
+	size_t prefaulted = 0;
+	std::thread thread([&prefaulted]() {
+		prefaulted = prefault_stack(size_t(1) << 40);
+	});
+	thread.join();
+	EXPECT_GT(prefaulted, 0u);
+
+	std::thread small_thread([&prefaulted]() {
+		prefaulted = prefault_stack(4096);
+	});
+	small_thread.join();
+	EXPECT_EQ(prefaulted, 4096u);
+}
+
+TEST(ThreadPlacement, RestoreThreadState)
+{
+	std::thread thread([]() {
+		std::string error;
+		thread_state_t state;
+		ASSERT_TRUE(save_thread_state(state, error)) << error;
+		EXPECT_EQ(state.tid, get_thread_id());
+
+		thread_config_t config;
+		config.cpus = {0};
+		ASSERT_TRUE(apply_thread_config(::pthread_self(), config, error)) << error;
+
+		cpu_set_t cpus;
+		ASSERT_EQ(::pthread_getaffinity_np(::pthread_self(), sizeof(cpus), &cpus), 0);
+		EXPECT_EQ(CPU_COUNT(&cpus), 1);
+
+		ASSERT_TRUE(restore_thread_state(state, error)) << error;
+		ASSERT_EQ(::pthread_getaffinity_np(::pthread_self(), sizeof(cpus), &cpus), 0);
+		EXPECT_TRUE(CPU_EQUAL(&cpus, &state.cpus));
+	});
+	thread.join();
+}
+
+TEST(ThreadPlacement, RestoreExitedThreadIsNoError)
+{
+	std::string error;
+	thread_state_t state;
+	std::thread thread([&state, &error]() {
+		EXPECT_TRUE(save_thread_state(state, error)) << error;
+	});
+	thread.join();
+	EXPECT_TRUE(restore_thread_state(state, error)) << error;
+}
@@ -0,0 +1,136 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2016, Neobotix GmbH
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Neobotix nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+#include "../include/WorkerPool.h"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <stdexcept>
+#include <vector>
+
+using namespace neo_local_planner;
+
+
+TEST(WorkerPool, ParallelForVisitsEachIndexOnce)
+{
+	WorkerPool pool(4);
+	std::vector<std::atomic<int>> visits(1000);
+	for(auto& count : visits) {
+		count = 0;
+	}
+	pool.parallelFor(visits.size(), [&visits](size_t i) { visits[i]++; });
+
+	for(size_t i = 0; i < visits.size(); ++i) {
+		EXPECT_EQ(visits[i], 1) << "index " << i;
+	}
+}
+
+TEST(WorkerPool, NestedParallelForDoesNotDeadlock)
+{
+	WorkerPool pool(2);
+	std::atomic<int> sum {0};
+	pool.parallelFor(8, [&pool, &sum](size_t) {
+		pool.parallelFor(8, [&sum](size_t j) { sum += int(j); });
+	});
+	EXPECT_EQ(sum, 8 * 28);
+}
+
+TEST(WorkerPool, ParallelForRethrows)
+{
+	WorkerPool pool(2);
+	EXPECT_THROW(pool.parallelFor(16, [](size_t i) {
+		if(i == 7) {
+			throw std::runtime_error("test");
+		}
+	}), std::runtime_error);
+}
+
+TEST(WorkerPool, DestructorRunsQueuedTasks)
+{
+	std::atomic<int> num_done {0};
+	{
+		WorkerPool pool(3);
+		for(int i = 0; i < 10000; ++i) {
+			pool.submit([&num_done]() { num_done++; });
+		}
+	}
+	EXPECT_EQ(num_done, 10000);
+}
+
+TEST(WorkerPool, ConcurrentSubmitAndSteal)
+{
+	// submitters race with workers stealing, the pool has to drain and shut down cleanly
+	std::atomic<int> num_done {0};
+	{
+		WorkerPool pool(4);
+		WorkerPool submitters(4);
+		submitters.parallelFor(4, [&pool, &num_done](size_t) {
+			for(int i = 0; i < 5000; ++i) {
+				pool.submit([&num_done]() { num_done++; });
+			}
+		});
+	}
+	EXPECT_EQ(num_done, 4 * 5000);
+}
+
+TEST(WorkerPool, SharedPoolReportsMismatch)
+{
+	std::string error;
+	const auto pool = WorkerPool::getShared(2, thread_config_t(), error);
+	EXPECT_TRUE(error.empty());
+	EXPECT_EQ(pool->numThreads(), 2);
+
+	const auto same = WorkerPool::getShared(2, thread_config_t(), error);
+	EXPECT_EQ(same, pool);
+	EXPECT_TRUE(error.empty());
+
+	const auto other = WorkerPool::getShared(3, thread_config_t(), error);
+	EXPECT_EQ(other, pool);
+	EXPECT_FALSE(error.empty());
+}
+
+TEST(WorkerPool, IsWorkerThread)
+{
+	EXPECT_FALSE(WorkerPool::isWorkerThread());
+
+	std::atomic<int> num_workers {0};
+	{
+		WorkerPool pool(2);
+		for(int i = 0; i < 100; ++i) {
+			pool.submit([&num_workers]() { num_workers += WorkerPool::isWorkerThread(); });
+		}
+	}
+	EXPECT_EQ(num_workers, 100);
+}